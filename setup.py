@@ -79,6 +79,9 @@ class pre_build(build_ext):
 
         build_ext.run(self)
 
+#Set UNCALLED_ZSTD=1 to decode VBZ compressed fast5s without the HDF5 plugin
+ZSTD = os.environ.get("UNCALLED_ZSTD", "0") == "1"
+
 uncalled = Extension(
     "_uncalled",
 
@@ -96,7 +99,13 @@ uncalled = Extension(
        "src/realtime_pool.cpp",
        "src/seed_tracker.cpp", 
        "src/normalizer.cpp", 
-       "src/range.cpp"
+       "src/range.cpp",
+       "src/numa.cpp",
+       "src/slow5_file.cpp",
+       "src/vbz.cpp",
+       "src/signal_cache.cpp",
+       "src/signal_gen.cpp",
+       "src/paf_writer.cpp"
     ],
 
     include_dirs = [
@@ -113,11 +122,11 @@ uncalled = Extension(
         "./submods/hdf5/lib"
     ],
 
-    libraries = ["bwa", "hdf5", "z", "dl", "m"],
+    libraries = ["bwa", "hdf5", "z", "dl", "m"] + (["zstd"] if ZSTD else []),
 
     extra_compile_args = ["-std=c++11", "-O3"],
 
-    define_macros = [("PYBIND", None)]
+    define_macros = [("PYBIND", None)] + ([("HAVE_ZSTD", None)] if ZSTD else [])
 )
 
 setup(
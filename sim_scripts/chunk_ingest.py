@@ -0,0 +1,80 @@
+#!/usr/bin/env python
+
+import sys
+import time
+import argparse
+import numpy as np
+import uncalled as unc
+
+def make_batch(num_channels, chunk_len, number):
+    raw = np.random.randint(400, 700, chunk_len).astype(np.int16)
+    return [("read_%d" % ch, ch, number, number*chunk_len, raw)
+            for ch in range(1, num_channels+1)]
+
+def time_rounds(fn, batches):
+    t0 = time.time()
+    for batch in batches:
+        fn(batch)
+    dt = time.time() - t0
+    nchunks = sum(len(b) for b in batches)
+    return nchunks / dt, 1000 * dt / len(batches)
+
+def report(name, rate, ms):
+    sys.stdout.write("%s\t%.0f\t%.3f\n" % (name, rate, ms))
+
+def chunks_from_bytes(batch):
+    return [unc.Chunk(i, c, n, s, "int16", r.tobytes()) for i,c,n,s,r in batch]
+
+def chunks_from_arrays(batch):
+    return [unc.Chunk(i, c, n, s, r) for i,c,n,s,r in batch]
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Measures how fast raw signal chunks can be passed from Python to UNCALLED, and the overhead of the realtime client loop")
+    parser.add_argument("-n", "--num-channels", type=int, default=3000, help="Number of channels, one chunk per channel per round")
+    parser.add_argument("-l", "--chunk-len", type=int, default=4000, help="Chunk length in samples")
+    parser.add_argument("-r", "--rounds", type=int, default=20, help="Number of chunk batches")
+    parser.add_argument("-x", "--bwa-prefix", type=str, default=None, help="BWA index prefix. If specified chunks are also added to a RealtimePool")
+    parser.add_argument("-t", "--threads", type=int, default=1, help="Number of mapping threads used by the RealtimePool")
+    args = parser.parse_args()
+
+    sys.stdout.write("method\tchunks_per_sec\tms_per_batch\n")
+
+    batches = [make_batch(args.num_channels, args.chunk_len, r+1)
+               for r in range(args.rounds)]
+
+    report("Chunk(bytes)", *time_rounds(chunks_from_bytes, batches))
+    report("Chunk(array)", *time_rounds(chunks_from_arrays, batches))
+
+    if args.bwa_prefix == None:
+        sys.exit(0)
+
+    conf = unc.Conf()
+    conf.bwa_prefix = args.bwa_prefix
+    conf.threads = args.threads
+    conf.num_channels = args.num_channels
+    conf.realtime_mode = unc.RealtimePool.DEPLETE
+
+    #Each pool sees its own reads, starting from inactive channels
+    pool = unc.RealtimePool(conf)
+    def add_each(batch):
+        for c in chunks_from_bytes(batch):
+            pool.add_chunk(c)
+    report("add_chunk", *time_rounds(add_each, batches))
+    pool.stop_all()
+
+    pool = unc.RealtimePool(conf)
+    report("add_chunks", *time_rounds(pool.add_chunks, batches))
+    pool.stop_all()
+
+    #Full client loop iterations: collect results, then add chunks
+    pool = unc.RealtimePool(conf)
+    def update_each(batch):
+        for ch, nm, paf in pool.update():
+            paf.print_paf()
+        add_each(batch)
+    report("update+add_chunk", *time_rounds(update_each, batches))
+    pool.stop_all()
+
+    pool = unc.RealtimePool(conf)
+    report("update_batch", *time_rounds(lambda b: pool.update_batch(b, True), batches))
+    pool.stop_all()
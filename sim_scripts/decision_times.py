@@ -0,0 +1,51 @@
+#!/usr/bin/env python
+
+import sys
+import argparse
+import numpy as np
+from uncalled.pafstats import parse_paf
+
+DECISION_TAGS = ["ej", "kp", "en"]
+TIME_TAGS = ["mt", "wt", "qt"]
+
+def summarize(name, vals):
+    vals = np.array(vals)
+    if len(vals) == 0:
+        return "%s\t0\tNA\tNA\tNA" % name
+    return "%s\t%d\t%.4f\t%.4f\t%.4f" % (
+            name, len(vals), np.mean(vals), 
+            np.percentile(vals, 50), np.percentile(vals, 99))
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Summarizes decision latency and mapping throughput of realtime or simulator runs")
+    parser.add_argument("paf_fnames", nargs="+", type=str, help="UNCALLED realtime or simulator output PAF files. Multiple files will be summarized side-by-side, for example to compare thread configurations")
+    args = parser.parse_args()
+
+    sys.stdout.write("file\tstat\tcount\tmean\tp50\tp99\n")
+
+    for fname in args.paf_fnames:
+        times = {t : list() for t in DECISION_TAGS + TIME_TAGS}
+        decisions = list()
+        bp_rates = list()
+
+        for p in parse_paf(fname):
+            for t in times:
+                v = p.get_tag(t)
+                if v != None:
+                    times[t].append(v)
+
+            #Seconds between receiving the last chunk and the decision
+            d = [p.get_tag(t) for t in DECISION_TAGS if p.get_tag(t) != None]
+            if len(d) > 0:
+                decisions.append(d[0])
+
+            mt = p.get_tag("mt")
+            if mt != None and mt > 0:
+                bp_rates.append(p.qr_len / mt)
+
+        rows = [summarize("decision", decisions)]
+        rows += [summarize(t, times[t]) for t in DECISION_TAGS + TIME_TAGS]
+        rows.append(summarize("bp_per_ms", bp_rates))
+
+        for r in rows:
+            sys.stdout.write("%s\t%s\n" % (fname, r))
@@ -0,0 +1,26 @@
+#!/usr/bin/env python
+
+import sys
+import time
+import argparse
+import uncalled as unc
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Measures how fast raw signal is loaded from fast5 files. Useful for comparing builds with and without native VBZ decoding")
+    parser.add_argument("fast5_list", type=str, help="File containing one fast5 filename per line")
+    parser.add_argument("-n", "--max-reads", type=int, default=0, help="Maximum number of reads to load")
+    args = parser.parse_args()
+
+    fast5s = unc.Fast5Reader(args.fast5_list, "", args.max_reads, 100)
+
+    nreads = nsamps = 0
+    t0 = time.time()
+    while not fast5s.empty():
+        read = fast5s.pop_read()
+        nreads += 1
+        nsamps += read.size()
+    dt = time.time() - t0
+
+    #Signal is stored as 16-bit integers
+    sys.stdout.write("reads\tsamples\tsec\treads_per_sec\tMB_per_sec\n")
+    sys.stdout.write("%d\t%d\t%.3f\t%.1f\t%.2f\n" % (nreads, nsamps, dt, nreads / dt, 2 * nsamps / dt / 1e6))
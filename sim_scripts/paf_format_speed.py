@@ -0,0 +1,36 @@
+#!/usr/bin/env python
+
+import sys
+import os
+import time
+import argparse
+from uncalled import pafstats
+
+def time_stats(fname, max_reads):
+    args = argparse.Namespace(infile=fname, max_reads=max_reads, ref_paf=None, annotate=False)
+    stdout = sys.stdout
+    sys.stdout = open(os.devnull, "w")
+    t0 = time.time()
+    pafstats.run(args)
+    dt = time.time() - t0
+    sys.stdout = stdout
+    return dt
+
+def time_parse(fname, max_reads):
+    t0 = time.time()
+    n = sum(1 for p in pafstats.parse_paf(fname, max_reads))
+    return n, time.time() - t0
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Compares the size and parse time of text PAF and binary (--binary-paf) output of the same run")
+    parser.add_argument("paf", type=str, help="Text PAF file")
+    parser.add_argument("binary", type=str, help="Binary mapping file from the same run")
+    parser.add_argument("-n", "--max-reads", type=int, default=None, help="Maximum number of reads to parse")
+    args = parser.parse_args()
+
+    sys.stdout.write("format\tMB\trecords\tparse_sec\tpafstats_sec\n")
+    for name, fname in [("text", args.paf), ("binary", args.binary)]:
+        mb = os.path.getsize(fname) / 1e6
+        n, parse = time_parse(fname, args.max_reads)
+        stats = time_stats(fname, args.max_reads)
+        sys.stdout.write("%s\t%.2f\t%d\t%.3f\t%.3f\n" % (name, mb, n, parse, stats))
@@ -138,6 +138,12 @@ class BwaIndex {
         return loaded_;
     }
 
+    //Loads reference names and sequences without the FM index
+    void load_seqs(const std::string &prefix) {
+        bns_ = bns_restore(prefix.c_str());
+        load_pacseq();
+    }
+
     void load_pacseq() {
         if (!pacseq_loaded()) {
             //Copied from bwa/bwase.c
@@ -215,6 +221,16 @@ class BwaIndex {
         return bns_->anns[rid].len;
     }
 
+    //Sets the reference sequence index and coordinate of a location,
+    //and returns the sequence length
+    u64 get_ref_loc(u64 sa_loc, i32 &rid, u64 &ref_loc) const {
+        rid = bns_pos2rid(bns_, sa_loc);
+        if (rid < 0) return 0;
+
+        ref_loc = sa_loc - bns_->anns[rid].offset;
+        return bns_->anns[rid].len;
+    }
+
     std::vector< std::pair<std::string, u64> > get_seqs() const {
         std::vector< std::pair<std::string, u64> > seqs;
 
@@ -246,7 +262,7 @@ class BwaIndex {
         return get_kmers(sti, eni);
     }
 
-    std::vector<u16> get_kmers(u64 st, u64 en) {
+    std::vector<u16> get_kmers(u64 st, u64 en) const {
         return seq_to_kmers<KLEN>(pacseq_, st, en);
     }
 
@@ -339,6 +355,7 @@ class BwaIndex {
         PY_BWA_INDEX_METH(load_index);
         PY_BWA_INDEX_METH(is_loaded);
         PY_BWA_INDEX_METH(load_pacseq);
+        PY_BWA_INDEX_METH(load_seqs);
         PY_BWA_INDEX_METH(destroy);
         PY_BWA_INDEX_METH(get_neighbor);
         PY_BWA_INDEX_METH(get_kmer_range);
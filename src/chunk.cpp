@@ -7,15 +7,25 @@ std::vector<float> Chunk::cal_offsets_,
 
 Chunk::Chunk() 
     : id_(""),
+      device_(0),
       channel_idx_(0),
       number_(0),
       start_time_(0),
       raw_data_() {}
 
 
+Chunk::Chunk(const std::string &id, u16 channel, u32 number, u64 start_time) 
+    : id_(id),
+      device_(0),
+      channel_idx_(channel-1),
+      number_(number),
+      start_time_(start_time),
+      raw_data_() {}
+
 Chunk::Chunk(const std::string &id, u16 channel, u32 number, u64 chunk_start, 
              const std::string &dtype, const std::string &raw_str) 
     : id_(id),
+      device_(0),
       channel_idx_(channel-1),
       number_(number),
       start_time_(chunk_start) {
@@ -53,6 +63,7 @@ Chunk::Chunk(const std::string &id, u16 channel, u32 number, u64 chunk_start,
 Chunk::Chunk(const std::string &id, u16 channel, u32 number, u64 start_time, 
              const std::vector<float> &raw_data, u32 raw_st, u32 raw_len) 
     : id_(id),
+      device_(0),
       channel_idx_(channel-1),
       number_(number),
       start_time_(start_time) {
@@ -90,6 +101,27 @@ bool Chunk::pop(std::vector<float> &raw_data) {
     return !raw_data.empty();
 }
 
+//Adds the signal from c onto the end of this chunk
+void Chunk::append(Chunk &c) {
+    raw_data_.insert(raw_data_.end(), c.raw_data_.begin(), c.raw_data_.end());
+    c.clear();
+}
+
+//Removes the first n samples, e.g. once they've been passed to a mapper
+void Chunk::skip(u32 n) {
+    if (n >= raw_data_.size()) {
+        start_time_ += raw_data_.size();
+        clear();
+        return;
+    }
+    raw_data_.erase(raw_data_.begin(), raw_data_.begin()+n);
+    start_time_ += n;
+}
+
+const std::vector<float> &Chunk::get_raw_data() const {
+    return raw_data_;
+}
+
 u64 Chunk::get_start() const {
     return start_time_;
 }
@@ -102,6 +134,14 @@ std::string Chunk::get_id() const {
     return id_;
 }
 
+u16 Chunk::get_device() const {
+    return device_;
+}
+
+void Chunk::set_device(u16 device) {
+    device_ = device;
+}
+
 u16 Chunk::get_channel_idx() const {
     return channel_idx_;
 }
@@ -120,6 +160,7 @@ void Chunk::set_start(u64 time) {
 
 void Chunk::swap(Chunk &c) {
     std::swap(id_, c.id_);
+    std::swap(device_, c.device_);
     std::swap(channel_idx_, c.channel_idx_);
     std::swap(number_, c.number_);
     std::swap(start_time_, c.start_time_);
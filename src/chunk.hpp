@@ -20,7 +20,23 @@ class Chunk {
     Chunk(const std::string &id, u16 channel, u32 number, u64 start_time, 
           const std::vector<float> &raw_data, u32 raw_st, u32 raw_len);
 
+    //Signal can be set later, e.g. with set_raw
+    Chunk(const std::string &id, u16 channel, u32 number, u64 start_time);
+
+    //Converts raw_len samples directly from an int16, int32, or float32 array
+    template <typename T>
+    Chunk(const std::string &id, u16 channel, u32 number, u64 start_time, 
+          const T *raw_arr, u32 raw_len) 
+        : id_(id),
+          device_(0),
+          channel_idx_(channel-1),
+          number_(number),
+          start_time_(start_time),
+          raw_data_(raw_arr, raw_arr + raw_len) {}
+
     bool pop(std::vector<float> &raw_data);
+    void append(Chunk &c);
+    void skip(u32 n);
     void swap(Chunk &c);
     void clear();
 
@@ -32,8 +48,13 @@ class Chunk {
     std::string get_id() const;
     u16 get_channel() const;
     u16 get_channel_idx() const;
+
+    //Index of the sequencing device the chunk came from, if a pool
+    //serves more than one flow cell
+    u16 get_device() const;
+    void set_device(u16 device);
     u32 get_number() const;
-    u32 get_raw_data() const;
+    const std::vector<float> &get_raw_data() const;
     u32 size() const;
     void print() const;
     void set_start(u64 time);
@@ -57,16 +78,61 @@ class Chunk {
             const std::vector<float> &, //raw_data, 
             u32, u32 //raw_st, raw_len
         >());
+        c.def(pybind11::init(&Chunk::from_buffer));
         PY_CHUNK_METH(pop);
         PY_CHUNK_METH(swap);
         PY_CHUNK_METH(empty);
         PY_CHUNK_METH(print);
         PY_CHUNK_METH(size);
         PY_CHUNK_RPROP(channel);
+        PY_CHUNK_PROP(device);
         PY_CHUNK_RPROP(number);
         PY_CHUNK_RPROP(id);
     }
 
+    //Accepts any object supporting the buffer protocol (numpy array,
+    //memoryview) so signal is only copied once, when converting to float
+    static Chunk from_buffer(const std::string &id, u16 channel, u32 number, 
+                             u64 start_time, pybind11::buffer raw) {
+        Chunk c(id, channel, number, start_time);
+        c.set_raw(raw.request());
+        return c;
+    }
+
+    //Throws pybind11::value_error if the buffer can't be used as signal
+    static void check_raw(const pybind11::buffer_info &raw) {
+        if (raw.ndim != 1 || raw.strides[0] != raw.itemsize) {
+            throw pybind11::value_error(
+                "raw signal must be a contiguous 1D array");
+        }
+
+        if (raw.format != pybind11::format_descriptor<i16>::format() &&
+            raw.format != pybind11::format_descriptor<i32>::format() &&
+            raw.format != pybind11::format_descriptor<float>::format()) {
+            throw pybind11::value_error(
+                "unsupported raw signal dtype, must be int16, int32, or float32");
+        }
+    }
+
+    //Buffer must be requested while holding the GIL, but signal can be
+    //set without it
+    void set_raw(const pybind11::buffer_info &raw) {
+        check_raw(raw);
+
+        if (raw.format == pybind11::format_descriptor<i16>::format()) {
+            const i16 *raw_arr = (const i16 *) raw.ptr;
+            raw_data_.assign(raw_arr, raw_arr + raw.size);
+
+        } else if (raw.format == pybind11::format_descriptor<i32>::format()) {
+            const i32 *raw_arr = (const i32 *) raw.ptr;
+            raw_data_.assign(raw_arr, raw_arr + raw.size);
+
+        } else {
+            const float *raw_arr = (const float *) raw.ptr;
+            raw_data_.assign(raw_arr, raw_arr + raw.size);
+        }
+    }
+
     #endif
 
     private:
@@ -75,7 +141,7 @@ class Chunk {
     static std::vector<float> cal_offsets_, cal_coefs_;
 
     std::string id_;
-    u16 channel_idx_;
+    u16 device_, channel_idx_;
     u32 number_;
     u64 start_time_;
     std::vector<float> raw_data_;
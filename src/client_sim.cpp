@@ -28,19 +28,35 @@ ClientSim::ClientSim(Conf &conf) :
       fast5s_(conf.fast5_prms),
       scan_start_(0),
       is_running_(false),
-      in_scan_(false) {
+      in_scan_(false),
+      vtime_(0),
+      lazy_load_(conf.get_max_loaded_mb() > 0),
+      max_samples_((u64) conf.get_max_loaded_mb() * (1 << 20) / sizeof(float)),
+      loaded_samples_(0),
+      load_threads_(conf.fast5_prms.load_threads),
+      stop_loading_(false) {
 
     float sample_rate = conf.get_sample_rate();
     time_coef_  = sample_rate / 1000;
     ej_time_    = PRMS.ej_time   * sample_rate;
     scan_time_  = PRMS.scan_time * sample_rate;
 
+    //Mapping must not time out on wall time spent between steps
+    if (PRMS.virtual_time) {
+        conf.mapper_prms.chunk_timeout = FLT_MAX;
+        conf.mapper_prms.evt_timeout = FLT_MAX;
+    }
+
     channels_.reserve(conf.get_num_channels());
     for (u32 c = 1; c <= conf.get_num_channels(); c++) {
         channels_.emplace_back(c);
     }
 }
 
+ClientSim::~ClientSim() {
+    stop_loading();
+}
+
 bool ClientSim::load_from_files(const std::string &prefix) {
     std::string itvs_file = prefix + "_itvs.txt",
                 gaps_file = prefix + "_gaps.txt",
@@ -158,25 +174,218 @@ void ClientSim::add_read(u16 ch, const std::string &id, u32 offs) {
     fast5s_.add_read(id);
 }
 
+//Signal caches are mapped rather than loaded through fast5s_
 void ClientSim::add_fast5(const std::string &fname) {
-    fast5s_.add_fast5(fname);
+    if (SignalCache::is_cache(fname)) {
+        caches_.emplace_back();
+        if (!caches_.back().open(fname)) caches_.pop_back();
+    } else {
+        fast5s_.add_fast5(fname);
+    }
+}
+
+//Synthetic reads are sequenced back to back on each channel, separated by
+//the generator's read gap. Channels stay active long enough for all of 
+//their reads at maximum length. Channels with loaded intervals keep them
+void ClientSim::add_generator(const SignalGen &gen) {
+    fast5s_.add_generator(gen);
+
+    std::vector<u64> counts(channels_.size(), 0);
+    for (u32 i = 0; i < gen.size(); i++) {
+        u16 ch = gen.get_channel(i);
+        if (ch > channels_.size()) continue;
+        add_read(ch, gen.get_id(i), 0);
+        counts[ch-1]++;
+    }
+
+    for (u16 c = 0; c < channels_.size(); c++) {
+        if (counts[c] == 0 || !channels_[c].intvs_.empty()) continue;
+        u64 end = min(counts[c] * gen.get_slot_len(), (u64) INT_MAX);
+        add_intv(c+1, 0, 0, end);
+        add_gap(c+1, 0, gen.get_gap_len());
+    }
 }
 
 
 void ClientSim::load_fast5s() {
     u32 n = 0;
-    while(!fast5s_.empty()) {
-        ReadBuffer read = fast5s_.pop_read();
-        ReadLoc r = read_locs[read.get_id()];
+
+    std::unordered_set<std::string> cached;
+    for (const SignalCache &cache : caches_) {
+        for (auto &l : read_locs) {
+            u32 c = cache.find(l.first);
+            if (c == cache.size() || !cached.insert(l.first).second) continue;
+
+            const ReadLoc &r = l.second;
+            channels_[r.ch-1].load_read(r.i, r.offs, cache, c);
+            n++;
+        }
+    }
+
+    if (!caches_.empty()) {
+        std::cerr << n << " mapped from signal cache\n";
+    }
+
+    if (lazy_load_) {
+        list_reads(cached);
+        return;
+    }
+
+    Timer t;
+
+    //Reads are loaded by load_threads threads
+    fast5s_.start_loading();
+
+    ReadBuffer read;
+    while (fast5s_.next_read(read)) {
+        if (cached.count(read.get_id()) > 0) continue;
+
+        auto l = read_locs.find(read.get_id());
+        if (l == read_locs.end()) continue;
+        const ReadLoc &r = l->second;
 
         read.set_channel(r.ch);
         channels_[r.ch-1].load_read(r.i, r.offs, read);
 
-        if (n % 1000 == 0) {
+        if (++n % 100000 == 0) {
             std::cerr << n << " loaded\n";
         }
+    }
+
+    fast5s_.stop_loading();
+    std::cerr << n << " reads loaded (" << (t.get() / 1000) << " sec)\n";
+}
+
+//Only lists read locations. Signal is loaded in the background once the 
+//simulation starts, in order of when each channel will need it
+void ClientSim::list_reads(std::unordered_set<std::string> &cached) {
+    std::cerr << "Listing reads\n";
+    read_infos_ = fast5s_.list_reads();
+
+    for (SimChannel &ch : channels_) {
+        ch.reads_.resize(ch.read_count_);
+    }
+
+    u32 n = 0;
+    for (u32 i = 0; i < read_infos_.size(); i++) {
+        auto l = read_locs.find(read_infos_[i].id);
+        if (l == read_locs.end() || !cached.insert(l->first).second) continue;
+
+        const ReadLoc &r = l->second;
+        channels_[r.ch-1].list_read(r.i, r.offs, i);
         n++;
     }
+    std::cerr << n << " reads listed\n";
+
+    for (u32 d = 0; d < LOAD_AHEAD; d++) {
+        for (u16 c = 0; c < channels_.size(); c++) {
+            if (d < channels_[c].reads_.size()) load_queue_.emplace_back(c, d);
+        }
+    }
+
+    u16 nthreads = load_threads_ > 0 ? load_threads_ : 1;
+    for (u16 i = 0; i < nthreads; i++) {
+        loaders_.emplace_back(&ClientSim::load_listed, this);
+    }
+}
+
+//Run by each loader thread. Reads the simulation is waiting for are
+//loaded first, regardless of max_loaded_mb
+void ClientSim::load_listed() {
+    Fast5Reader fast5s;
+    fast5s.copy_listed(fast5s_);
+
+    std::unique_lock<std::mutex> lck(load_mtx_);
+    while (true) {
+        load_cv_.wait(lck, [this] {
+            return stop_loading_ || !need_queue_.empty() || 
+                   (!load_queue_.empty() && loaded_samples_ < max_samples_);
+        });
+        if (stop_loading_) break;
+
+        std::deque< std::pair<u16, u32> > &queue = 
+            need_queue_.empty() ? load_queue_ : need_queue_;
+        u16 c = queue.front().first;
+        SimRead &r = channels_[c].reads_[queue.front().second];
+        queue.pop_front();
+
+        if (r.loaded_ || r.loading_) continue;
+        r.loading_ = true;
+        u32 info = r.info_, offs = r.offs_;
+
+        lck.unlock();
+
+        ReadBuffer read;
+        SimRead tmp;
+        if (fast5s.load_read(read_infos_[info], read)) {
+            read.set_channel(c+1);
+            tmp.load_read(read, offs);
+        } else {
+            std::cerr << "Error: failed to load read \"" 
+                      << read_infos_[info].id << "\"\n";
+        }
+
+        lck.lock();
+
+        //Reads which fail to load are simulated as empty
+        r.install(tmp);
+        r.loading_ = false;
+        loaded_samples_ += r.signal_.size();
+        loaded_cv_.notify_all();
+    }
+}
+
+//Called with load_mtx_ locked
+void ClientSim::wait_loaded(std::unique_lock<std::mutex> &lck, u16 c, u32 i) {
+    SimRead &r = channels_[c].reads_[i];
+    if (r.loaded_) return;
+
+    need_queue_.emplace_back(c, i);
+    load_cv_.notify_all();
+    loaded_cv_.wait(lck, [&r] {return r.loaded_;});
+}
+
+//Frees signal which has been simulated, and requests the reads a channel 
+//will need next if it moved past any since r0. Called with load_mtx_ locked
+void ClientSim::update_loaded(u16 c, u32 r0) {
+    SimChannel &ch = channels_[c];
+    u32 n = ch.reads_.size();
+    if (n == 0) return;
+
+    u64 freed = 0;
+
+    //Channels with one read repeat it, so its signal is kept
+    SimRead &cur = ch.reads_[ch.r_];
+    if (n > 1 && cur.info_ != UINT_MAX && cur.c_ >= cur.chunk_count_) {
+        freed += cur.release_signal();
+    }
+
+    u32 ahead = min(LOAD_AHEAD, n);
+    for (u32 i = r0; i != ch.r_; i = (i+1) % n) {
+        SimRead &r = ch.reads_[i];
+        if (r.info_ != UINT_MAX) {
+            freed += r.release_signal();
+            r.loaded_ = false;
+        }
+        load_queue_.emplace_back(c, (i + ahead) % n);
+    }
+
+    if (freed > 0 || ch.r_ != r0) {
+        loaded_samples_ -= freed;
+        load_cv_.notify_all();
+    }
+}
+
+void ClientSim::stop_loading() {
+    load_mtx_.lock();
+    stop_loading_ = true;
+    load_mtx_.unlock();
+    load_cv_.notify_all();
+
+    for (std::thread &t : loaders_) {
+        t.join();
+    }
+    loaders_.clear();
 }
 
 
@@ -209,9 +418,17 @@ bool ClientSim::load_reads(const std::string &fname) {
 
 
 bool ClientSim::run() {
+    if (lazy_load_) {
+        std::unique_lock<std::mutex> lck(load_mtx_);
+        for (u16 c = 0; c < channels_.size(); c++) {
+            if (!channels_[c].reads_.empty()) wait_loaded(lck, c, 0);
+        }
+    }
+
     is_running_ = true;
     in_scan_ = false;
     timer_.reset();
+    vtime_ = 0;
     for (SimChannel &ch : channels_) {
         ch.start(0);
     }
@@ -243,6 +460,10 @@ std::vector< std::pair<u16, Chunk> > ClientSim::get_read_chunks() {
 
     is_running_ = false;
 
+    //Loaders only modify reads which aren't loaded
+    std::unique_lock<std::mutex> lck(load_mtx_, std::defer_lock);
+    if (lazy_load_) lck.lock();
+
     for (u16 c = 0; c < channels_.size(); c++) {
         SimChannel &ch = channels_[c];
 
@@ -255,8 +476,19 @@ std::vector< std::pair<u16, Chunk> > ClientSim::get_read_chunks() {
 
         is_running_ = true; 
 
+        //Current read must be loaded before it starts, and the next read
+        //before the current one ends
+        u32 r0 = ch.r_;
+        if (lazy_load_ && !ch.reads_.empty()) {
+            wait_loaded(lck, c, r0);
+            if (ch.reads_[r0].ended(time)) {
+                wait_loaded(lck, c, (r0+1) % ch.reads_.size());
+            }
+        }
+
         if (!ch.is_active(time)) {
             intvs_ended = ch.intv_ended(time) && intvs_ended;
+            if (lazy_load_) update_loaded(c, r0);
             continue;
         }
 
@@ -265,6 +497,8 @@ std::vector< std::pair<u16, Chunk> > ClientSim::get_read_chunks() {
         while (ch.chunk_ready(time)) {
             ret.push_back( std::pair<u16, Chunk>(c+1, ch.next_chunk(time)));
         }
+
+        if (lazy_load_) update_loaded(c, r0);
     }
 
     if (intvs_ended && !in_scan_) {
@@ -298,14 +532,40 @@ u32 ClientSim::unblock_read(u16 ch, u32 number) {
     return channels_[ch-1].unblock(get_time(), ej_time_);
 }
 
-float ClientSim::get_time() {
+double ClientSim::get_time() {
+    if (PRMS.virtual_time) return vtime_;
     return (timer_.get() * time_coef_);
 }
 
 float ClientSim::get_runtime() {
+    if (PRMS.virtual_time) return vtime_ / time_coef_ / 1000;
     return timer_.get() / 1000;
 }
 
+//Charges mapping time to the virtual clock
+void ClientSim::advance(float ms) {
+    if (PRMS.virtual_time) vtime_ += ms * time_coef_ * PRMS.compute_scale;
+}
+
+//Jumps the virtual clock to the next chunk or channel state change,
+//or forward one sample if nothing is pending
+void ClientSim::skip_to_next_event() {
+    if (!PRMS.virtual_time || !is_running_) return;
+
+    u64 next = UINT_MAX;
+    if (in_scan_) {
+        next = (u64) scan_start_ + scan_time_;
+    } else {
+        for (SimChannel &ch : channels_) {
+            next = min(next, (u64) ch.next_event());
+        }
+    }
+
+    u64 now = vtime_;
+    if (next <= now || next == UINT_MAX) next = now + 1;
+    vtime_ = next;
+}
+
 bool ClientSim::is_running() {
     return is_running_;
 }
@@ -25,11 +25,17 @@
 #define _INCL_SIM_POOL
 
 #include <unordered_map>
+#include <unordered_set>
 #include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "util.hpp"
 #include "chunk.hpp"
 #include "read_buffer.hpp" 
 #include "fast5_reader.hpp" 
+#include "signal_cache.hpp" 
+#include "signal_gen.hpp" 
 #include "conf.hpp" 
 
 class ClientSim {
@@ -43,6 +49,10 @@ class ClientSim {
     bool is_running();
     float get_runtime();
 
+    //Virtual time only, see SimParams::virtual_time
+    void advance(float ms);
+    void skip_to_next_event();
+
     bool load_from_files(const std::string &prefix);
 
     void add_intv(u16 ch, u16 i, u32 st, u32 en);
@@ -50,8 +60,11 @@ class ClientSim {
     void add_delay(u16 ch, u16 i, u32 len);
     void add_read(u16 ch, const std::string &id, u32 offs);
     void add_fast5(const std::string &fname);
+    void add_generator(const SignalGen &gen);
     void load_fast5s();
 
+    ~ClientSim();
+
     #ifdef PYBIND
 
     #define PY_SIM_METH(P) c.def(#P, &ClientSim::P);
@@ -62,6 +75,8 @@ class ClientSim {
         c.def(pybind11::init<Conf &>());
         PY_SIM_METH(run);
         PY_SIM_METH(get_runtime);
+        PY_SIM_METH(advance);
+        PY_SIM_METH(skip_to_next_event);
         PY_SIM_METH(get_read_chunks);
         PY_SIM_METH(stop_receiving_read);
         PY_SIM_METH(unblock_read);
@@ -70,6 +85,8 @@ class ClientSim {
         PY_SIM_METH(add_delay);
         PY_SIM_METH(add_read);
         PY_SIM_METH(add_fast5);
+        c.def("add_generator", &ClientSim::add_generator,
+              pybind11::keep_alive<1, 2>());
         PY_SIM_METH(load_fast5s);
 
         PY_SIM_RPROP(is_running);
@@ -84,9 +101,15 @@ class ClientSim {
     bool load_delays(const std::string &fname);
     bool load_reads(const std::string &fname);
 
+    void list_reads(std::unordered_set<std::string> &cached);
+    void load_listed();
+    void wait_loaded(std::unique_lock<std::mutex> &lck, u16 c, u32 i);
+    void update_loaded(u16 c, u32 r0);
+    void stop_loading();
+
 
     u32 get_number(u16 channel);
-    float get_time();
+    double get_time();
 
     typedef struct {
         u16 ch;
@@ -135,6 +158,11 @@ class ClientSim {
             return active_bounds_.back();
         }
 
+        u32 next_bound() const {
+            if (active_bounds_.empty()) return UINT_MAX;
+            return start_time_ + active_bounds_.front();
+        }
+
         bool is_active(u32 t) {
             while (!active_bounds_.empty() && intv_time(t) >= active_bounds_.front()) {
                 active_bounds_.pop_front();
@@ -184,31 +212,96 @@ class ClientSim {
     class SimRead {
         //private:
         public:
-        std::vector<Chunk> chunks_;
         u8 c_;
         u32 start_, end_, duration_, number_;
 
+        //Signal of the chunks to be simulated, from the read offset up to
+        //max_chunks. Chunks are only created as they're popped
+        std::string id_;
+        std::vector<float> signal_;
+
+        //Reads from a SignalCache aren't copied. Chunks are calibrated
+        //from the mapped signal when they're popped
+        const i16 *cache_sig_;
+        const SignalCache::ReadMeta *cache_meta_;
+        u16 channel_, chunk_len_;
+        u32 chunk_count_;
+
+        //Reads loaded in the background have their ReadInfo index and 
+        //offset stored so they can be reloaded if the channel wraps around
+        u32 info_, offs_;
+        bool loaded_, loading_;
+
         SimRead() :
             c_(0),
             start_(0),
             end_(0),
             duration_(0),
-            number_(0) {}
+            number_(0),
+            cache_sig_(NULL),
+            cache_meta_(NULL),
+            channel_(0),
+            chunk_len_(0),
+            chunk_count_(0),
+            info_(UINT_MAX),
+            offs_(0),
+            loaded_(true),
+            loading_(false) {}
+
+        //Chunks match those from ReadBuffer::get_chunks
+        void set_chunks(u32 len, u32 offs) {
+            chunk_len_ = ReadBuffer::PRMS.slice_len();
+            u64 max_len = (u64) ReadBuffer::PRMS.max_chunks * ReadBuffer::PRMS.chunk_len();
+            len = len > offs ? len - offs : 0;
+            chunk_count_ = min(len / chunk_len_, 
+                               (max_len + chunk_len_ - 1) / chunk_len_);
+        }
 
         void load_read(const ReadBuffer &read, u32 offs) {
+            id_ = read.get_id();
+            channel_ = read.get_channel();
             duration_ = read.get_duration();
-            read.get_chunks(chunks_, false, offs);
             number_ = read.get_number();
+
+            const std::vector<float> &raw = read.get_raw();
+            set_chunks(raw.size(), offs);
+            signal_.assign(raw.begin() + offs, 
+                           raw.begin() + offs + (u64) chunk_count_ * chunk_len_);
+            loaded_ = true;
+        }
+
+        void load_read(const SignalCache &cache, u32 i, u16 channel, u32 offs) {
+            cache_meta_ = &cache.get_meta(i);
+            cache_sig_ = cache.get_signal(i) + offs;
+            channel_ = channel;
+            duration_ = cache_meta_->length;
+            number_ = cache_meta_->number;
+            set_chunks(duration_, offs);
+            loaded_ = true;
+        }
+
+        //Takes signal and metadata from a read loaded by a loader thread
+        void install(SimRead &r) {
+            id_.swap(r.id_);
+            signal_.swap(r.signal_);
+            channel_ = r.channel_;
+            duration_ = r.duration_;
+            number_ = r.number_;
+            chunk_len_ = r.chunk_len_;
+            chunk_count_ = r.chunk_count_;
+            loaded_ = true;
+        }
+
+        //Frees signal once all chunks have been popped
+        u64 release_signal() {
+            u64 n = signal_.size();
+            std::vector<float>().swap(signal_);
+            return n;
         }
 
         void start(u32 t) {
             start_ = t;
             end_ = start_ + duration_;
-            u64 i = start_;
-            for (auto &ch : chunks_) {
-                ch.set_start(i);
-                i += ch.size();
-            }
             c_ = 0;
         }
 
@@ -216,10 +309,14 @@ class ClientSim {
             return start_ != 0 && start_ <= t;
         }
 
+        u64 chunk_end(u32 c) {
+            return start_ + (u64) (c+1) * chunk_len_;
+        }
+
         bool chunk_ready(u32 t) {
             return started(t) && 
-                   c_ < chunks_.size() && 
-                   t >= chunks_[c_].get_end();
+                   c_ < chunk_count_ && 
+                   t >= chunk_end(c_);
         }
 
         u32 get_number() {
@@ -227,8 +324,26 @@ class ClientSim {
         }
 
         Chunk pop_chunk() {
-            assert(c_ < chunks_.size());
-            return chunks_[c_++];
+            assert(c_ < chunk_count_);
+
+            u64 st = start_ + (u64) c_ * chunk_len_;
+            u64 i = (u64) c_ * chunk_len_;
+            c_++;
+
+            if (cache_sig_ == NULL) {
+                return Chunk(id_, channel_, number_, st, 
+                             signal_.data() + i, chunk_len_);
+            }
+
+            const SignalCache::ReadMeta &m = *cache_meta_;
+            const i16 *sig = cache_sig_ + i;
+            std::vector<float> raw(chunk_len_);
+            for (u16 j = 0; j < chunk_len_; j++) {
+                u16 r = sig[j];
+                raw[j] = (m.cal_range * r / m.cal_digit) + m.cal_offset;
+            }
+
+            return Chunk(m.id, channel_, number_, st, raw, 0, chunk_len_);
         }
 
         u64 get_end() {
@@ -240,7 +355,7 @@ class ClientSim {
         }
 
         void stop_receiving() {
-            c_ = chunks_.size();
+            c_ = chunk_count_;
         }
 
         void unblock(u32 t, u32 delay) {
@@ -307,6 +422,20 @@ class ClientSim {
             reads_[i].load_read(read, offs);
         }
 
+        void list_read(u32 i, u32 offs, u32 info) {
+            reads_[i].info_ = info;
+            reads_[i].offs_ = offs;
+            reads_[i].loaded_ = false;
+        }
+
+        void load_read(u32 i, u32 offs, const SignalCache &cache, u32 c) {
+            if (reads_.size() < read_count_) {
+                reads_.resize(read_count_);
+            }
+
+            reads_[i].load_read(cache, c, channel_, offs);
+        }
+
         void add_delay(u32 i, u32 delay) {
             while (i >= intvs_.size()) {
                 intvs_.emplace_back(channel_, intvs_.size());
@@ -334,7 +463,9 @@ class ClientSim {
 
             u32 end = reads_[r_].get_end();
             while (t >= end) {
-                r_ = (r_+1) % reads_.size();
+                u32 next = (r_+1) % reads_.size();
+                if (!reads_[next].loaded_) break;
+                r_ = next;
 
                 reads_[r_].start(end + intvs_[0].next_gap() + extra_gap_);
                 extra_gap_ = 0;
@@ -357,6 +488,20 @@ class ClientSim {
             return is_dead() || intvs_[0].get_end() <= t;
         }
 
+        //Next time a chunk could be ready or the channel could switch
+        //state. Only valid after get_read_chunks has updated the channel
+        u32 next_event() {
+            if (is_dead()) return UINT_MAX;
+
+            u32 t = intvs_[0].next_bound();
+            if (is_active_) {
+                SimRead &r = reads_[r_];
+                u64 e = r.c_ < r.chunk_count_ ? r.chunk_end(r.c_) : r.get_end();
+                if (e < t) t = e;
+            }
+            return t;
+        }
+
         void next_intv(u32 t) {
             intvs_.pop_front();
             if (!is_dead()) intvs_[0].start(t);
@@ -378,6 +523,7 @@ class ClientSim {
 
     SimParams PRMS;
     Fast5Reader fast5s_;
+    std::deque<SignalCache> caches_;
     float time_coef_; //TODO: make const?
     u32 ej_time_, ej_delay_, scan_time_, scan_start_; //start_samp_, end_samp_, 
 
@@ -385,6 +531,22 @@ class ClientSim {
     bool is_running_, in_scan_;
 
     Timer timer_;
+    double vtime_; //samples
+
+    //If max_loaded_mb is set, read signal is loaded by load_threads 
+    //threads up to LOAD_AHEAD reads ahead of each channel, and freed once
+    //it's been simulated. Unloaded reads are requested in load_queue_, 
+    //or in need_queue_ if the simulation is waiting for them
+    static const u32 LOAD_AHEAD = 3;
+    bool lazy_load_;
+    u64 max_samples_, loaded_samples_;
+    std::vector<Fast5Reader::ReadInfo> read_infos_;
+    std::deque< std::pair<u16, u32> > load_queue_, need_queue_;
+    u16 load_threads_;
+    std::vector<std::thread> loaders_;
+    std::mutex load_mtx_;
+    std::condition_variable load_cv_, loaded_cv_;
+    bool stop_loading_;
     
     std::vector<SimChannel> channels_;
 };
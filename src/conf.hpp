@@ -29,6 +29,8 @@
 #include <cfloat>
 #include "mapper.hpp"
 #include "fast5_reader.hpp"
+#include "signal_gen.hpp"
+#include "paf_writer.hpp"
 #include "toplevel_prms.hpp"
 #include "toml.hpp"
 
@@ -40,6 +42,7 @@
 
 const std::string ACTIVE_STRS[] = {"full", "even", "odd"};
 const std::string MODE_STRS[] = {"deplete", "enrich"};
+const std::string SCHEDULE_STRS[] = {"round_robin", "deadline"};
 
 #define GET_SET(T, N) T get_##N() { return N; } \
                       void set_##N(const T &v) { N = v; }
@@ -63,6 +66,12 @@ class Conf {
     Mode mode;
     u16 threads;
 
+    //Pin mapping threads to NUMA nodes, each using a local index copy
+    bool numa;
+
+    //Write PAF output in PafWriter's binary format
+    bool binary_paf;
+
     Mapper::Params &mapper_prms = Mapper::PRMS;
     EventDetector::Params &event_prms = mapper_prms.event_prms;
     EventProfiler::Params &evt_prof_prms = mapper_prms.evt_prof_prms;
@@ -73,11 +82,14 @@ class Conf {
     Fast5Reader::Params fast5_prms = Fast5Reader::PRMS_DEF;
     static constexpr Fast5Reader::Docstrs fast5_docs = Fast5Reader::DOCSTRS;
 
+    SignalGen::Params gen_prms = SignalGen::PRMS_DEF;
+    static constexpr SignalGen::Docstrs gen_docs = SignalGen::DOCSTRS;
+
     RealtimeParams realtime_prms = REALTIME_PRMS_DEF;
     SimParams sim_prms = SIM_PRMS_DEF;
     MapOrdParams map_ord_prms = MAP_ORD_PRMS_DEF;
 
-    Conf() : mode(Mode::UNDEF), threads(1) {}
+    Conf() : mode(Mode::UNDEF), threads(1), numa(false), binary_paf(false) {}
 
     Conf(Mode m) : Conf() {
         mode = m;
@@ -100,6 +112,8 @@ class Conf {
         if (conf.contains("global")) {
             const auto subconf = toml::find(conf, "global");
             GET_TOML(u16, threads);
+            GET_TOML(bool, numa);
+            GET_TOML(bool, binary_paf);
         }
 
         if (conf.contains("realtime")) {
@@ -108,6 +122,9 @@ class Conf {
             GET_TOML_EXTERN(u16, port, realtime_prms);
             GET_TOML_EXTERN(float, duration, realtime_prms);
             GET_TOML_EXTERN(u32, max_active_reads, realtime_prms);
+            GET_TOML_EXTERN(u16, signal_threads, realtime_prms);
+            GET_TOML_EXTERN(u16, num_devices, realtime_prms);
+            GET_TOML_EXTERN(float, shed_age, realtime_prms);
 
             if (subconf.contains("realtime_mode")) {
                 std::string mode_str = toml::find<std::string>(subconf, "realtime_mode");
@@ -119,6 +136,23 @@ class Conf {
                 }
             }
 
+            if (subconf.contains("device_modes")) {
+                auto mode_strs = toml::find<std::vector<std::string>>(subconf, "device_modes");
+                realtime_prms.device_modes.clear();
+                for (auto &mode_str : mode_strs) {
+                    u8 i;
+                    for (i = 0; i != (u8) RealtimeParams::Mode::NUM; i++) {
+                        if (mode_str == MODE_STRS[i]) break;
+                    }
+                    if (i == (u8) RealtimeParams::Mode::NUM) {
+                        std::cerr << "Error: unknown device mode \"" 
+                                  << mode_str << "\"\n";
+                        continue;
+                    }
+                    realtime_prms.device_modes.push_back((RealtimeParams::Mode) i);
+                }
+            }
+
             if (subconf.contains("active_chs")) {
                 std::string mode_str = toml::find<std::string>(subconf, "active_chs");
                 for (u8 i = 0; i != (u8) RealtimeParams::ActiveChs::NUM; i++) {
@@ -128,6 +162,16 @@ class Conf {
                     }
                 }
             }
+
+            if (subconf.contains("schedule")) {
+                std::string sched_str = toml::find<std::string>(subconf, "schedule");
+                for (u8 i = 0; i != (u8) RealtimeParams::Schedule::NUM; i++) {
+                    if (sched_str == SCHEDULE_STRS[i]) {
+                        realtime_prms.schedule = (RealtimeParams::Schedule) i;
+                        break;
+                    }
+                }
+            }
         }
 
         //TODO rename subsection
@@ -141,11 +185,14 @@ class Conf {
             GET_TOML_EXTERN(float, scan_intv_time, sim_prms);
             GET_TOML_EXTERN(float, ej_time, sim_prms);
             GET_TOML_EXTERN(u32, min_ch_reads, sim_prms);
+            GET_TOML_EXTERN(bool, virtual_time, sim_prms);
+            GET_TOML_EXTERN(float, compute_scale, sim_prms);
         }
 
         if (conf.contains("map_ord")) {
             const auto subconf = toml::find(conf, "map_ord");
             GET_TOML_EXTERN(u32, min_active_reads, map_ord_prms);
+            GET_TOML_EXTERN(u32, max_loaded_mb, map_ord_prms);
         }
 
         if (conf.contains("fast5_reader")) {
@@ -153,8 +200,29 @@ class Conf {
 
             GET_TOML_EXTERN(u32, max_buffer, fast5_prms);
             GET_TOML_EXTERN(u32, max_reads, fast5_prms);
+            GET_TOML_EXTERN(u16, load_threads, fast5_prms);
             GET_TOML_EXTERN(std::string, fast5_list, fast5_prms);
             GET_TOML_EXTERN(std::string, read_list, fast5_prms);
+            GET_TOML_EXTERN(std::string, fast5_index, fast5_prms);
+        }
+
+        if (conf.contains("signal_gen")) {
+            const auto subconf = toml::find(conf, "signal_gen");
+
+            GET_TOML_EXTERN(u32, gen_reads, gen_prms);
+            GET_TOML_EXTERN(u32, gen_seed, gen_prms);
+            GET_TOML_EXTERN(u32, min_read_len, gen_prms);
+            GET_TOML_EXTERN(u32, max_read_len, gen_prms);
+            GET_TOML_EXTERN(float, unmapped_frac, gen_prms);
+            GET_TOML_EXTERN(float, dwell_shape, gen_prms);
+            GET_TOML_EXTERN(float, stay_prob, gen_prms);
+            GET_TOML_EXTERN(float, skip_prob, gen_prms);
+            GET_TOML_EXTERN(float, level_noise, gen_prms);
+            GET_TOML_EXTERN(float, sample_noise, gen_prms);
+            GET_TOML_EXTERN(float, scale_stdv, gen_prms);
+            GET_TOML_EXTERN(float, shift_stdv, gen_prms);
+            GET_TOML_EXTERN(float, drift, gen_prms);
+            GET_TOML_EXTERN(float, read_gap, gen_prms);
         }
 
         if (conf.contains("reads")) {
@@ -164,6 +232,7 @@ class Conf {
             GET_TOML_EXTERN(u16, bp_per_sec,   read_prms);
             GET_TOML_EXTERN(u16, sample_rate,  read_prms);
             GET_TOML_EXTERN(float, chunk_time, read_prms);
+            GET_TOML_EXTERN(float, slice_time, read_prms);
             GET_TOML_EXTERN(u16, num_channels, read_prms);
         }
 
@@ -224,6 +293,12 @@ class Conf {
     }
 
     GET_SET(u16, threads)
+    GET_SET(bool, numa)
+    GET_SET(bool, binary_paf)
+
+    PafWriter::Format get_paf_format() {
+        return binary_paf ? PafWriter::Format::BINARY : PafWriter::Format::TEXT;
+    }
 
 
     //TODO define get<type, param>, set<type, param>, doc<type, param>
@@ -235,15 +310,37 @@ class Conf {
 
     GET_SET_DOC(fast5, std::string, fast5_list)
     GET_SET_DOC(fast5, std::string, read_list)
+    GET_SET_DOC(fast5, std::string, fast5_index)
     GET_SET_DOC(fast5, u32, max_reads)
     GET_SET_DOC(fast5, u32, max_buffer)
+    GET_SET_DOC(fast5, u16, load_threads)
+
+    GET_SET_DOC(gen, u32, gen_reads)
+    GET_SET_DOC(gen, u32, gen_seed)
+    GET_SET_DOC(gen, u32, min_read_len)
+    GET_SET_DOC(gen, u32, max_read_len)
+    GET_SET_DOC(gen, float, unmapped_frac)
+    GET_SET_DOC(gen, float, dwell_shape)
+    GET_SET_DOC(gen, float, stay_prob)
+    GET_SET_DOC(gen, float, skip_prob)
+    GET_SET_DOC(gen, float, level_noise)
+    GET_SET_DOC(gen, float, sample_noise)
+    GET_SET_DOC(gen, float, scale_stdv)
+    GET_SET_DOC(gen, float, shift_stdv)
+    GET_SET_DOC(gen, float, drift)
+    GET_SET_DOC(gen, float, read_gap)
 
     GET_SET_EXTERN(std::string, realtime_prms, host)
     GET_SET_EXTERN(u16, realtime_prms, port)
     GET_SET_EXTERN(float, realtime_prms, duration)
     GET_SET_EXTERN(u32, realtime_prms, max_active_reads)
+    GET_SET_EXTERN(u16, realtime_prms, signal_threads)
     GET_SET_EXTERN(RealtimeParams::ActiveChs, realtime_prms, active_chs)
     GET_SET_EXTERN(RealtimeParams::Mode, realtime_prms, realtime_mode)
+    GET_SET_EXTERN(u16, realtime_prms, num_devices)
+    GET_SET_EXTERN(std::vector<RealtimeParams::Mode>, realtime_prms, device_modes)
+    GET_SET_EXTERN(RealtimeParams::Schedule, realtime_prms, schedule)
+    GET_SET_EXTERN(float, realtime_prms, shed_age)
 
     GET_SET_EXTERN(u32, evt_prof_prms, win_len)
     GET_SET_EXTERN(float, evt_prof_prms, win_stdv_min)
@@ -260,6 +357,7 @@ class Conf {
     GET_SET_EXTERN(u16,   read_prms, num_channels);
     GET_SET_EXTERN(u32,   read_prms, max_chunks)
     GET_SET_EXTERN(float, read_prms, chunk_time);
+    GET_SET_EXTERN(float, read_prms, slice_time);
     GET_SET_EXTERN(float, read_prms, sample_rate);
 
 
@@ -271,8 +369,11 @@ class Conf {
     GET_SET_EXTERN(float, sim_prms, scan_intv_time);
     GET_SET_EXTERN(float, sim_prms, ej_time);
     GET_SET_EXTERN(u32, sim_prms, min_ch_reads);
+    GET_SET_EXTERN(bool, sim_prms, virtual_time);
+    GET_SET_EXTERN(float, sim_prms, compute_scale);
 
     GET_SET_EXTERN(u32, map_ord_prms, min_active_reads);
+    GET_SET_EXTERN(u32, map_ord_prms, max_loaded_mb);
 
     
 
@@ -290,12 +391,15 @@ class Conf {
          .def("load_toml", &Conf::load_toml);
 
         DEFPRP(threads)
+        DEFPRP(numa)
+        DEFPRP(binary_paf)
 
         DEFPRP(bwa_prefix)
         DEFPRP(idx_preset)
         DEFPRP(max_events)
         DEFPRP(seed_len);
         DEFPRP(chunk_time)
+        DEFPRP(slice_time)
 
         #ifdef DEBUG_OUT
         DEFPRP(dbg_prefix)
@@ -303,21 +407,45 @@ class Conf {
 
         DEFPRP_DOC(fast5_list)
         DEFPRP_DOC(read_list)
+        DEFPRP_DOC(fast5_index)
         DEFPRP_DOC(max_reads)
         DEFPRP_DOC(max_buffer)
+        DEFPRP_DOC(load_threads)
+
+        DEFPRP_DOC(gen_reads)
+        DEFPRP_DOC(gen_seed)
+        DEFPRP_DOC(min_read_len)
+        DEFPRP_DOC(max_read_len)
+        DEFPRP_DOC(unmapped_frac)
+        DEFPRP_DOC(dwell_shape)
+        DEFPRP_DOC(stay_prob)
+        DEFPRP_DOC(skip_prob)
+        DEFPRP_DOC(level_noise)
+        DEFPRP_DOC(sample_noise)
+        DEFPRP_DOC(scale_stdv)
+        DEFPRP_DOC(shift_stdv)
+        DEFPRP_DOC(drift)
+        DEFPRP_DOC(read_gap)
+        c.def_readwrite("gen_prms", &Conf::gen_prms);
 
         DEFPRP(host)
         DEFPRP(port)
         DEFPRP(duration)
         DEFPRP(max_active_reads)
+        DEFPRP(signal_threads)
         DEFPRP(active_chs)
         DEFPRP(realtime_mode)
+        DEFPRP(num_devices)
+        DEFPRP(device_modes)
+        DEFPRP(schedule)
+        DEFPRP(shed_age)
 
         DEFPRP(num_channels)
         DEFPRP(max_chunks)
         DEFPRP(sample_rate)
 
         DEFPRP(min_active_reads)
+        DEFPRP(max_loaded_mb)
 
         DEFPRP(ctl_seqsum)
         DEFPRP(unc_seqsum)
@@ -327,6 +455,8 @@ class Conf {
         DEFPRP(scan_intv_time)
         DEFPRP(ej_time)
         DEFPRP(min_ch_reads)
+        DEFPRP(virtual_time)
+        DEFPRP(compute_scale)
     }
     #endif
 };
@@ -69,6 +69,11 @@ int main(int argc, char** argv) {
         out_prefix = std::string(argv[4]);
     }
 
+    std::string fast5_index = "";
+    if (argc > 5) {
+        fast5_index = std::string(argv[5]);
+    }
+
     const PoreModel<KLEN> model(DEF_MODEL, false);
 
     auto costfn = [&model](float e, u16 k) {return -model.match_prob(e,k);};
@@ -91,6 +96,11 @@ int main(int argc, char** argv) {
 
     auto queries = load_queries(query_fname, fast5s);
 
+    //Queried reads are found through the index instead of listing the file
+    if (!fast5_index.empty()) {
+        fast5s.load_index(fast5_index);
+    }
+
 
     while (!fast5s.empty()) {
         //Get next read and corrasponding query
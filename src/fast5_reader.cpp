@@ -23,13 +23,19 @@
 
 #include <thread>
 #include <chrono>
+#include <climits>
+#include <fstream>
+#include <sstream>
 #include "fast5_reader.hpp"
+#include "signal_gen.hpp"
 
 const Fast5Reader::Params Fast5Reader::PRMS_DEF = {
     fast5_list : "",
     read_list  : "",
-    max_reads  : 0,
-    max_buffer : 100
+    max_reads    : 0,
+    max_buffer   : 100,
+    load_threads : 1,
+    fast5_index  : ""
 };
 
 const std::string Fast5Reader::FMT_RAW_PATHS[] = {
@@ -42,14 +48,27 @@ const std::string Fast5Reader::FMT_CH_PATHS[] = {
     "/UniqueGlobalKey/channel_id" //SINGLE
 };
 
+const std::string Fast5Reader::FMT_NAMES[] = {
+    "multi", //MULTI
+    "single" //SINGLE
+};
+
 Fast5Reader::Fast5Reader() : 
     Fast5Reader(PRMS_DEF) {}
 
-Fast5Reader::Fast5Reader(const Params &p) : PRMS(p) {
+Fast5Reader::Fast5Reader(const Params &p) 
+    : PRMS(p),
+      gen_(NULL),
+      indexed_(false),
+      next_info_file_(0),
+      read_queue_(p.max_buffer),
+      active_loaders_(0) {
+
     total_buffered_ = 0;
 
     if (!PRMS.read_list.empty()) load_read_list(PRMS.read_list);
     if (!PRMS.fast5_list.empty()) load_fast5_list(PRMS.fast5_list);
+    if (!PRMS.fast5_index.empty()) load_index(PRMS.fast5_index);
 }
 
 Fast5Reader::Fast5Reader(const std::string &fast5_list, 
@@ -58,7 +77,14 @@ Fast5Reader::Fast5Reader(const std::string &fast5_list,
     : PRMS({fast5_list, 
             read_list, 
             max_reads, 
-            max_buffer}) {
+            max_buffer,
+            PRMS_DEF.load_threads,
+            PRMS_DEF.fast5_index}),
+      gen_(NULL),
+      indexed_(false),
+      next_info_file_(0),
+      read_queue_(max_buffer),
+      active_loaders_(0) {
 
     total_buffered_ = 0;
     if (!PRMS.fast5_list.empty()) load_fast5_list(PRMS.fast5_list);
@@ -68,10 +94,21 @@ Fast5Reader::Fast5Reader(const std::string &fast5_list,
 Fast5Reader::Fast5Reader(u32 max_reads, u32 max_buffer) 
     : Fast5Reader("","",max_reads,max_buffer) {}
 
+Fast5Reader::~Fast5Reader() {
+    stop_loading();
+}
+
 void Fast5Reader::add_fast5(const std::string &fast5_path) {
     fast5_list_.push_back(fast5_path);
 }
 
+void Fast5Reader::add_generator(const SignalGen &gen) {
+    gen_ = &gen;
+    for (const std::string &fname : gen.list_files()) {
+        add_fast5(fname);
+    }
+}
+
 bool Fast5Reader::load_fast5_list(const std::string &fname) {
     std::ifstream list_file(fname);
 
@@ -116,6 +153,301 @@ bool Fast5Reader::load_read_list(const std::string &fname) {
     return true;
 }
 
+//Removes directories from a file path
+static std::string file_basename(const std::string &path) {
+    size_t i = path.find_last_of('/');
+    if (i == std::string::npos) return path;
+    return path.substr(i+1);
+}
+
+u32 Fast5Reader::build_index(const std::string &out_fname, u16 nthreads) {
+    std::ofstream out(out_fname);
+
+    if (!out.is_open()) {
+        std::cerr << "Error: failed to open fast5 index \""
+                  << out_fname << "\".\n";
+        return 0;
+    }
+
+    out << "read_id\tfile\tformat\tgroup\tchannel\tstart_sample\tlength\n";
+
+    std::deque<std::string> fnames(fast5_list_);
+    std::mutex mtx;
+    u32 count = 0;
+
+    //Files are always scanned, even if an index was already loaded
+    bool indexed = indexed_;
+    indexed_ = false;
+
+    //Each thread lists whole files, then writes all of their reads at once
+    auto index_files = [&]() {
+        ReadFile file;
+        std::deque<std::string> read_paths;
+
+        while (true) {
+            std::string fname;
+            mtx.lock();
+            if (!fnames.empty()) {
+                fname = fnames.front();
+                fnames.pop_front();
+            }
+            mtx.unlock();
+
+            if (fname.empty()) break;
+
+            //slow5 files and signal caches are indexed when opened
+            if (Slow5File::is_slow5(fname) || Slow5File::is_blow5(fname) ||
+                SignalCache::is_cache(fname) || SignalGen::is_gen(fname)) {
+                continue;
+            }
+
+            read_paths.clear();
+            if (!open_fast5(fname, file, read_paths)) {
+                std::cerr << "Error: failed to index \"" << fname << "\"\n";
+                close_file(file);
+                continue;
+            }
+
+            hdf5_tools::File &fast5 = file.fast5;
+            Format fmt = file.fmt;
+
+            std::ostringstream lines;
+            u32 nreads = 0;
+            for (const std::string &read_path : read_paths) {
+                std::string raw_path, ch_path;
+                if (!get_read_paths(fmt, read_path, raw_path, ch_path)) continue;
+
+                std::string id, start = "0", length = "0", channel = "0";
+                for (auto a : fast5.get_attr_map(raw_path)) {
+                    if (a.first == "read_id") {
+                        id = a.second;
+                    } else if (a.first == "start_time") {
+                        start = a.second;
+                    } else if (a.first == "duration") {
+                        length = a.second;
+                    }
+                }
+                for (auto a : fast5.get_attr_map(ch_path)) {
+                    if (a.first == "channel_number") {
+                        channel = a.second;
+                        break;
+                    }
+                }
+
+                lines << id << "\t" << fname << "\t" << FMT_NAMES[fmt] << "\t" 
+                      << read_path << "\t" << channel << "\t" 
+                      << start << "\t" << length << "\n";
+                nreads++;
+            }
+            close_file(file);
+
+            mtx.lock();
+            out << lines.str();
+            count += nreads;
+            mtx.unlock();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (u16 i = 1; i < nthreads; i++) {
+        threads.emplace_back(index_files);
+    }
+    index_files();
+
+    for (std::thread &t : threads) {
+        t.join();
+    }
+
+    indexed_ = indexed;
+    return count;
+}
+
+bool Fast5Reader::load_index(const std::string &fname) {
+    std::ifstream infile(fname);
+
+    if (!infile.is_open()) {
+        std::cerr << "Error: failed to open fast5 index \""
+                  << fname << "\".\n";
+        return false;
+    }
+
+    std::string line, read_id, fast5_name, fmt_name, group;
+    u16 channel;
+    u64 start;
+    getline(infile, line); //header
+
+    while (getline(infile, line)) {
+        std::istringstream cols(line);
+        if (!(cols >> read_id >> fast5_name >> fmt_name >> group 
+                   >> channel >> start)) continue;
+
+        if (!read_filter_.empty() && read_filter_.count(read_id) == 0) {
+            continue;
+        }
+
+        IndexedFile &f = index_[file_basename(fast5_name)];
+        f.fmt = fmt_name == FMT_NAMES[Format::SINGLE] ? Format::SINGLE : Format::MULTI;
+        f.read_paths.push_back(group);
+        f.reads.push_back({read_id, group, channel, start, 0});
+    }
+
+    indexed_ = true;
+    return true;
+}
+
+std::vector<Fast5Reader::ReadInfo> Fast5Reader::list_reads() {
+    std::vector<ReadInfo> reads;
+    ReadFile file;
+    std::deque<std::string> read_paths;
+
+    while (!fast5_list_.empty()) {
+        std::string fname = fast5_list_.front();
+        fast5_list_.pop_front();
+
+        u32 f = info_fnames_.size();
+
+        bool use_index = indexed_ && 
+                         !Slow5File::is_slow5(fname) && 
+                         !Slow5File::is_blow5(fname) &&
+                         !SignalCache::is_cache(fname) &&
+                         !SignalGen::is_gen(fname);
+
+        if (use_index) {
+            auto i = index_.find(file_basename(fname));
+            if (i == index_.end()) continue;
+
+            info_fnames_.push_back(fname);
+            info_fmts_.push_back(i->second.fmt);
+            for (ReadInfo r : i->second.reads) {
+                r.file = f;
+                reads.push_back(r);
+            }
+            continue;
+        }
+
+        read_paths.clear();
+        if (!open_fast5(fname, file, read_paths)) {
+            close_file(file);
+            continue;
+        }
+
+        info_fnames_.push_back(fname);
+        info_fmts_.push_back(file.fmt);
+
+        for (const std::string &path : read_paths) {
+            ReadInfo r = {"", path, 0, 0, f};
+            if (read_info(file, r)) reads.push_back(r);
+        }
+        close_file(file);
+    }
+
+    if (PRMS.max_reads > 0 && reads.size() > PRMS.max_reads) {
+        reads.resize(PRMS.max_reads);
+    }
+
+    return reads;
+}
+
+//Reads the ID, channel, and start of info.path
+bool Fast5Reader::read_info(ReadFile &file, ReadInfo &info) {
+    if (file.fmt == Format::SLOW5) {
+        info.id = info.path;
+        return file.slow5.read_meta(info.path, info.channel, info.start);
+    }
+
+    if (file.fmt == Format::CACHE) {
+        u32 i = file.cache.find(info.path);
+        if (i == file.cache.size()) return false;
+        info.id = info.path;
+        info.channel = file.cache.get_meta(i).channel;
+        info.start = file.cache.get_meta(i).start_sample;
+        return true;
+    }
+
+    if (file.fmt == Format::GEN) {
+        u32 i = atoi(info.path.c_str());
+        info.id = file.gen->get_id(i);
+        info.channel = file.gen->get_channel(i);
+        info.start = file.gen->get_start(i);
+        return true;
+    }
+
+    std::string raw_path, ch_path;
+    if (!get_read_paths(file.fmt, info.path, raw_path, ch_path)) {
+        return false;
+    }
+
+    for (auto a : file.fast5.get_attr_map(raw_path)) {
+        if (a.first == "read_id") {
+            info.id = a.second;
+        } else if (a.first == "start_time") {
+            info.start = atoll(a.second.c_str());
+        }
+    }
+
+    for (auto a : file.fast5.get_attr_map(ch_path)) {
+        if (a.first == "channel_number") {
+            info.channel = atoi(a.second.c_str());
+            break;
+        }
+    }
+
+    return !info.id.empty();
+}
+
+bool Fast5Reader::load_read(const ReadInfo &info, ReadBuffer &read) {
+    if (info.file >= info_fnames_.size()) return false;
+
+    u32 i;
+    for (i = 0; i < info_files_.size(); i++) {
+        if (info_file_idxs_[i] == info.file) break;
+    }
+
+    //Replaces the least recently opened file
+    if (i == info_files_.size()) {
+        if (info_files_.size() < MAX_INFO_FILES) {
+            info_files_.emplace_back();
+            info_file_idxs_.push_back(info.file);
+        } else {
+            i = next_info_file_;
+            next_info_file_ = (next_info_file_ + 1) % MAX_INFO_FILES;
+            close_file(info_files_[i]);
+            info_file_idxs_[i] = info.file;
+        }
+
+        if (!open_format(info_fnames_[info.file], info_fmts_[info.file], 
+                         info_files_[i])) {
+            info_file_idxs_[i] = UINT_MAX;
+            return false;
+        }
+    }
+
+    return load_read(info_files_[i], info.path, read);
+}
+
+void Fast5Reader::copy_listed(const Fast5Reader &r) {
+    info_fnames_ = r.info_fnames_;
+    info_fmts_ = r.info_fmts_;
+    gen_ = r.gen_;
+}
+
+bool Fast5Reader::open_format(const std::string &fname, Format fmt, 
+                              ReadFile &file) {
+    file.fmt = fmt;
+    switch (fmt) {
+        case Format::SLOW5:
+            return file.slow5.open(fname);
+        case Format::CACHE:
+            return file.cache.open(fname);
+        case Format::GEN:
+            file.gen = gen_;
+            return gen_ != NULL;
+        default:
+            file.fast5.open(fname);
+            return file.fast5.is_open();
+    }
+}
+
 bool Fast5Reader::empty() {
     return buffered_reads_.empty() && 
            read_paths_.empty() && 
@@ -125,29 +457,111 @@ bool Fast5Reader::empty() {
 bool Fast5Reader::open_next() {
 
     read_paths_.clear();
-    if (open_fast5_.is_open()) open_fast5_.close();
-    if (fast5_list_.empty()) return false;
+    close_file(open_file_);
+
+    //Files which fail to open are skipped, open_fast5 reports why
+    while (!fast5_list_.empty()) {
+        std::string fname = fast5_list_.front();
+        fast5_list_.pop_front();
 
-    open_fast5_.open(fast5_list_.front());
-    fast5_list_.pop_front();
+        if (open_fast5(fname, open_file_, read_paths_)) return true;
 
-    open_fmt_ = Format::UNKNOWN;
-    for (const std::string &s : open_fast5_.list_group("/")) {
+        read_paths_.clear();
+        close_file(open_file_);
+    }
+
+    return false;
+}
+
+void Fast5Reader::close_file(ReadFile &file) {
+    if (file.fast5.is_open()) file.fast5.close();
+    if (file.slow5.is_open()) file.slow5.close();
+    if (file.cache.is_open()) file.cache.close();
+    file.gen = NULL;
+}
+
+//Opens a fast5, slow5, or signal cache file and lists the paths of reads
+//which pass the filter. Paths of slow5 and cached reads are their IDs,
+//and synthetic reads are listed by their index in the generator
+bool Fast5Reader::open_fast5(const std::string &fname, 
+                             ReadFile &file,
+                             std::deque<std::string> &read_paths) {
+
+    hdf5_tools::File &fast5 = file.fast5;
+    Format &fmt = file.fmt;
+
+    if (Slow5File::is_slow5(fname) || Slow5File::is_blow5(fname)) {
+        if (!file.slow5.open(fname)) return false;
+
+        fmt = Format::SLOW5;
+        for (const std::string &id : file.slow5.get_read_ids()) {
+            if (read_filter_.empty() || read_filter_.count(id) > 0) {
+                read_paths.push_back(id);
+            }
+        }
+        return true;
+    }
+
+    if (SignalCache::is_cache(fname)) {
+        if (!file.cache.open(fname)) return false;
+
+        fmt = Format::CACHE;
+        for (u32 i = 0; i < file.cache.size(); i++) {
+            std::string id = file.cache.get_meta(i).id;
+            if (read_filter_.empty() || read_filter_.count(id) > 0) {
+                read_paths.push_back(id);
+            }
+        }
+        return true;
+    }
+
+    if (SignalGen::is_gen(fname)) {
+        if (gen_ == NULL) return false;
+
+        file.gen = gen_;
+        fmt = Format::GEN;
+        u32 st, en;
+        gen_->file_reads(fname, st, en);
+        for (u32 i = st; i < en; i++) {
+            if (read_filter_.empty() || read_filter_.count(gen_->get_id(i)) > 0) {
+                read_paths.push_back(std::to_string(i));
+            }
+        }
+        return true;
+    }
+
+    //Indexed files without selected reads are never opened
+    if (indexed_) {
+        auto f = index_.find(file_basename(fname));
+        if (f == index_.end()) return true;
+
+        fast5.open(fname);
+        fmt = f->second.fmt;
+        read_paths.insert(read_paths.end(), 
+                          f->second.read_paths.begin(), 
+                          f->second.read_paths.end());
+        return true;
+    }
+
+    fast5.open(fname);
+
+    fmt = Format::UNKNOWN;
+    for (const std::string &s : fast5.list_group("/")) {
         if (s == "Raw") {
-            open_fmt_ = Format::SINGLE;
+            fmt = Format::SINGLE;
             break;
         }
     }
-    if (open_fmt_ == Format::UNKNOWN) open_fmt_ = Format::MULTI; //TODO: add support for old multi format
+    if (fmt == Format::UNKNOWN) fmt = Format::MULTI; //TODO: add support for old multi format
 
 
     std::string path;
-    switch (open_fmt_) {
+    switch (fmt) {
     case Format::SINGLE:
         path = FMT_RAW_PATHS[Format::SINGLE];
-        for (const std::string &read : open_fast5_.list_group(path)) {
+        for (const std::string &read : fast5.list_group(path)) {
             std::string read_id = "";
-            for (auto a : open_fast5_.get_attr_map(path+"/"+read)) {
+            for (auto a : fast5.get_attr_map(path+"/"+read)) {
                 if (a.first == "read_id") {
                     read_id = a.second;
                     break;
@@ -160,16 +574,16 @@ bool Fast5Reader::open_next() {
             }
             
             if (read_filter_.empty() || read_filter_.count(read_id) > 0) {
-                read_paths_.push_back("/"+read);
+                read_paths.push_back("/"+read);
             }
         }
         return true;
 
     case Format::MULTI:
-        for (const std::string &read : open_fast5_.list_group("/")) {
+        for (const std::string &read : fast5.list_group("/")) {
             std::string id = read.substr(read.find('_')+1);
             if (read_filter_.empty() || read_filter_.count(id) > 0) {
-                read_paths_.push_back("/"+read);
+                read_paths.push_back("/"+read);
             }
         }
         return true;
@@ -180,6 +594,51 @@ bool Fast5Reader::open_next() {
     return false; 
 }
 
+bool Fast5Reader::load_read(ReadFile &file, 
+                            const std::string &read_path,
+                            ReadBuffer &read) {
+    if (file.fmt == Format::SLOW5) {
+        return file.slow5.read(read_path, read);
+    }
+
+    if (file.fmt == Format::CACHE) {
+        u32 i = file.cache.find(read_path);
+        if (i == file.cache.size()) return false;
+        read = file.cache.get_read(i);
+        return true;
+    }
+
+    if (file.fmt == Format::GEN) {
+        read = file.gen->get_read(atoi(read_path.c_str()));
+        return true;
+    }
+
+    std::string raw_path, ch_path;
+    if (!get_read_paths(file.fmt, read_path, raw_path, ch_path)) {
+        return false;
+    }
+
+    read = ReadBuffer(file.fast5, raw_path, ch_path);
+    return true;
+}
+
+bool Fast5Reader::get_read_paths(Format fmt, const std::string &read_path,
+                                 std::string &raw_path, std::string &ch_path) {
+    switch (fmt) {
+        case Format::SINGLE:
+            raw_path = FMT_RAW_PATHS[fmt] + read_path;
+            ch_path = FMT_CH_PATHS[fmt];
+            return true;
+        case Format::MULTI:
+            raw_path = read_path + FMT_RAW_PATHS[fmt],
+            ch_path =  read_path + FMT_CH_PATHS[fmt];
+            return true;
+        default:
+            std::cerr << "Error: unrecognized fast5 format\n";
+            return false;
+    }
+}
+
 u32 Fast5Reader::fill_buffer() {
     u32 count = 0;
 
@@ -197,28 +656,13 @@ u32 Fast5Reader::fill_buffer() {
         }
         if (read_paths_.empty()) break;
 
-        std::string raw_path, ch_path;
-
-        switch (open_fmt_) {
-            case Format::SINGLE:
-                raw_path = FMT_RAW_PATHS[open_fmt_] + read_paths_.front();
-                ch_path = FMT_CH_PATHS[open_fmt_];
-                break;
-            case Format::MULTI:
-                raw_path = read_paths_.front() + FMT_RAW_PATHS[open_fmt_],
-                ch_path =  read_paths_.front() + FMT_CH_PATHS[open_fmt_];
-                break;
-            default:
-                std::cerr << "Error: unrecognized fast5 format\n";
-                read_paths_.pop_front();
-                return count;
-        }
-
-        //std::string raw_path = read_paths_.front() + FMT_RAW_PATHS[open_fmt_],
-        //            ch_path =  read_paths_.front() + FMT_CH_PATHS[open_fmt_];
+        ReadBuffer read;
+        bool valid = load_read(open_file_, read_paths_.front(), read);
         read_paths_.pop_front();
 
-        buffered_reads_.emplace_back(open_fast5_, raw_path, ch_path);
+        if (!valid) continue;
+
+        buffered_reads_.push_back(read);
 
         count++;
         total_buffered_++;
@@ -236,6 +680,12 @@ ReadBuffer Fast5Reader::pop_read() {
     if (buffer_size() == 0) { 
         fill_buffer();
     }
+
+    //Only reached if every remaining read failed to load
+    if (buffer_size() == 0) {
+        return ReadBuffer();
+    }
+
     //TODO: swap to speed up?
     ReadBuffer r = buffered_reads_.front();
     buffered_reads_.pop_front();
@@ -246,3 +696,79 @@ u32 Fast5Reader::buffer_size() {
     return buffered_reads_.size();
 }
 
+void Fast5Reader::start_loading() {
+    if (!loaders_.empty()) return;
+
+    u16 nthreads = PRMS.load_threads > 0 ? PRMS.load_threads : 1;
+    active_loaders_ = nthreads;
+
+    for (u16 i = 0; i < nthreads; i++) {
+        loaders_.emplace_back(&Fast5Reader::load_reads, this);
+    }
+}
+
+void Fast5Reader::stop_loading() {
+    read_queue_.close();
+    read_queue_.clear();
+
+    for (std::thread &t : loaders_) {
+        t.join();
+    }
+    loaders_.clear();
+}
+
+bool Fast5Reader::next_read(ReadBuffer &r) {
+    return read_queue_.pop(r);
+}
+
+//Run by each loader thread. Loaders take whole files from the list, so
+//each has its own open file. max_reads and the read filter are enforced
+//by counting reads before they are loaded
+void Fast5Reader::load_reads() {
+    ReadFile file;
+    file.fmt = Format::UNKNOWN;
+    std::deque<std::string> read_paths;
+
+    while (true) {
+        while (read_paths.empty()) {
+            std::string fname;
+
+            list_mtx_.lock();
+            if (!fast5_list_.empty() && !all_buffered()) {
+                fname = fast5_list_.front();
+                fast5_list_.pop_front();
+            }
+            list_mtx_.unlock();
+
+            if (fname.empty()) break;
+
+            close_file(file);
+            if (!open_fast5(fname, file, read_paths)) {
+                read_paths.clear();
+            }
+        }
+        if (read_paths.empty()) break;
+
+        list_mtx_.lock();
+        bool load = !all_buffered();
+        if (load) total_buffered_++;
+        list_mtx_.unlock();
+
+        if (!load) break;
+
+        ReadBuffer read;
+        bool valid = load_read(file, read_paths.front(), read);
+        read_paths.pop_front();
+
+        if (valid && !read_queue_.push(std::move(read))) {
+            break;
+        }
+    }
+
+    close_file(file);
+
+    //Last loader to finish lets consumers know there are no more reads
+    if (--active_loaders_ == 0) {
+        read_queue_.close();
+    }
+}
@@ -28,13 +28,21 @@
 #include <vector>
 #include <deque>
 #include <unordered_set>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
 #include "read_buffer.hpp"
+#include "mpmc_queue.hpp"
+#include "slow5_file.hpp"
+#include "signal_cache.hpp"
 #include "util.hpp"
 
 #ifdef PYBIND
 #include <pybind11/pybind11.h>
 #endif
 
+class SignalGen;
+
 class Fast5Reader {
     public:
 
@@ -42,24 +50,40 @@ class Fast5Reader {
         std::string fast5_list;
         std::string read_list;
         u32 max_reads, max_buffer;
+        u16 load_threads;
+        std::string fast5_index;
     } Params;
     static Params const PRMS_DEF;
 
     typedef struct {
-        const char *fast5_list, *read_list, *max_reads, *max_buffer;
+        const char *fast5_list, *read_list, *max_reads, *max_buffer, 
+                   *load_threads, *fast5_index;
     } Docstrs;
     static constexpr Docstrs DOCSTRS = {
         fast5_list : 
-            "File containing a list of paths to fast5 files, one per line.",
+            "File containing a list of paths to fast5 or slow5 files, one per line.",
         read_list : 
             "File containing a list of read IDs. Only these reads will be loaded if specified.",
         max_reads : 
             "Maximum number of reads to load.",
         max_buffer : 
-            "Maximum number of reads to store in memory."
+            "Maximum number of reads to store in memory.",
+        load_threads :
+            "Number of threads loading fast5 reads in the background. Each thread reads from its own file.",
+        fast5_index :
+            "Read ID index built by \"uncalled fast5-index\". If specified only fast5 files containing selected reads are opened, without listing their contents."
     };
 
 
+    //Location and start time of a read, used to load reads out of 
+    //file order. file indexes the files listed by list_reads
+    typedef struct {
+        std::string id, path;
+        u16 channel;
+        u64 start;
+        u32 file;
+    } ReadInfo;
+
     //TODO: remove reduntant constructors
 
     Fast5Reader();
@@ -70,14 +94,41 @@ class Fast5Reader {
                 const std::string &read_list="",
                 u32 max_reads=0, u32 max_buffer=100);
 
+    ~Fast5Reader();
+
     void add_fast5(const std::string &fast5_path);
 
+    //Adds synthetic reads, generated as they're loaded. The generator 
+    //must outlive the reader
+    void add_generator(const SignalGen &gen);
+
     bool load_fast5_list(const std::string &fname);
 
     bool add_read(const std::string &read_id);
 
     bool load_read_list(const std::string &fname);
 
+    //Writes a tab-separated index of all reads in the fast5 files:
+    //read ID, file, format, group, channel, start sample, and length.
+    //Files are scanned by nthreads threads. Returns number of reads indexed
+    u32 build_index(const std::string &out_fname, u16 nthreads=1);
+
+    //Loads an index written by build_index. Only reads which pass the
+    //read filter are kept, so the read list must be loaded first
+    bool load_index(const std::string &fname);
+
+    //Lists the reads of all remaining files which pass the filter, without
+    //loading signal. Uses the fast5 index if loaded instead of opening files
+    std::vector<ReadInfo> list_reads();
+
+    //Loads a read listed by list_reads. The last few files used are kept
+    //open. Not thread safe
+    bool load_read(const ReadInfo &info, ReadBuffer &read);
+
+    //Lets this reader load reads listed by r, so they can be loaded by 
+    //several threads each with their own reader
+    void copy_listed(const Fast5Reader &r);
+
     ReadBuffer pop_read();
  
     u32 buffer_size();
@@ -88,6 +139,15 @@ class Fast5Reader {
  
     bool empty();
 
+    //Starts load_threads threads which fill a queue of up to max_buffer
+    //reads in the background. Reads must then be taken with next_read
+    void start_loading();
+    void stop_loading();
+
+    //Thread safe. Waits for the next loaded read, returns false once 
+    //all reads have been taken or loading is stopped
+    bool next_read(ReadBuffer &r);
+
     #ifdef PYBIND
 
     #define PY_FAST5_METH(N) c.def(#N, &Fast5Reader::N);
@@ -104,9 +164,14 @@ class Fast5Reader {
                 u32, u32>());
 
         PY_FAST5_METH(add_fast5);
+        c.def("add_generator", &Fast5Reader::add_generator,
+              pybind11::keep_alive<1, 2>());
         PY_FAST5_METH(load_fast5_list);
         PY_FAST5_METH(add_read);
         PY_FAST5_METH(load_read_list);
+        PY_FAST5_METH(load_index);
+        c.def("build_index", &Fast5Reader::build_index,
+              pybind11::arg("out_fname"), pybind11::arg("nthreads")=1);
         PY_FAST5_METH(pop_read);
         PY_FAST5_METH(buffer_size);
         PY_FAST5_METH(fill_buffer);
@@ -118,6 +183,8 @@ class Fast5Reader {
         PY_FAST5_PRM(read_list);
         PY_FAST5_PRM(max_reads);
         PY_FAST5_PRM(max_buffer);
+        PY_FAST5_PRM(load_threads);
+        PY_FAST5_PRM(fast5_index);
     }
 
     #endif
@@ -125,21 +192,68 @@ class Fast5Reader {
     private:
     Params PRMS;
 
-    enum Format {MULTI, SINGLE, UNKNOWN};
+    enum Format {MULTI, SINGLE, SLOW5, CACHE, GEN, UNKNOWN};
     static const std::string FMT_RAW_PATHS[], FMT_CH_PATHS[];
+    static const std::string FMT_NAMES[];
+
+    //The file being loaded, opened with the handle matching its format
+    typedef struct {
+        hdf5_tools::File fast5;
+        Slow5File slow5;
+        SignalCache cache;
+        const SignalGen *gen = NULL;
+        Format fmt;
+    } ReadFile;
 
     bool open_next();
+    bool open_fast5(const std::string &fname, 
+                    ReadFile &file,
+                    std::deque<std::string> &read_paths);
+    static void close_file(ReadFile &file);
+    static bool load_read(ReadFile &file, 
+                          const std::string &read_path,
+                          ReadBuffer &read);
+    bool open_format(const std::string &fname, Format fmt, ReadFile &file);
+    static bool read_info(ReadFile &file, ReadInfo &info);
+    static bool get_read_paths(Format fmt, const std::string &read_path,
+                               std::string &raw_path, std::string &ch_path);
+
+    void load_reads();
 
     u32 max_buffer_, total_buffered_, max_reads_;
 
     std::deque<std::string> fast5_list_;
     std::unordered_set<std::string> read_filter_;
+    const SignalGen *gen_;
 
-    hdf5_tools::File open_fast5_;
-    Format open_fmt_;
+    //Selected read groups of each indexed file, keyed by file name
+    //without directories so indices stay valid if fast5s are moved
+    typedef struct {
+        Format fmt;
+        std::deque<std::string> read_paths;
+        std::vector<ReadInfo> reads;
+    } IndexedFile;
+    std::unordered_map<std::string, IndexedFile> index_;
+    bool indexed_;
+
+    ReadFile open_file_;
+
+    //Files listed by list_reads, and files opened by load_read
+    static const u32 MAX_INFO_FILES = 8;
+    std::vector<std::string> info_fnames_;
+    std::vector<Format> info_fmts_;
+    std::deque<ReadFile> info_files_;
+    std::vector<u32> info_file_idxs_;
+    u32 next_info_file_;
     std::deque<std::string> read_paths_;
 
     std::deque<ReadBuffer> buffered_reads_;
+
+    //Background loading. list_mtx_ guards fast5_list_ and total_buffered_
+    MpmcQueue<ReadBuffer> read_queue_;
+    std::vector<std::thread> loaders_;
+    std::atomic<u16> active_loaders_;
+    std::mutex list_mtx_;
 };
 
 #endif
@@ -26,58 +26,58 @@
 #include "map_pool.hpp"
 
 MapPool::MapPool(Conf &conf)
-    : fast5s_(conf.fast5_prms) {
+    : fast5s_(conf.fast5_prms),
+      loading_(false),
+      pafs_(conf.fast5_prms.max_buffer) {
 
-    threads_ = std::vector<MapperThread>(conf.threads);
+    threads_.reserve(conf.threads);
+    for (u16 i = 0; i < conf.threads; i++) {
+        threads_.emplace_back(fast5s_, pafs_, results_);
+    }
 
-    //fast5s_.fill_buffer();
+    if (conf.numa) {
+        Mapper::load_replicas();
+        for (u16 i = 0; i < conf.threads; i++) {
+            threads_[i].numa_ = true;
+            threads_[i].numa_node_ = Numa::thread_node(i, conf.threads);
+        }
+    }
 
     for (u32 i = 0; i < threads_.size(); i++) {
-        //if (!fast5s_.empty()) {
-        //    ReadBuffer r = fast5s_.pop_read();
-        //    threads_[i].next_read_.swap(r);
-        //    threads_[i].in_buffered_ = true;
-        //}
         threads_[i].start();
     }
 }
 
+//Reads are loaded once all fast5s have been added
 std::vector<Paf> MapPool::update() {
-    std::vector<Paf> ret;
-
-    fast5s_.fill_buffer();
-
-    for (u32 i = 0; i < threads_.size(); i++) {
-        if (threads_[i].out_buffered_) {
-            ret.push_back(threads_[i].paf_out_);
-            threads_[i].out_buffered_ = false;
-        }
-
-
-        if (!threads_[i].in_buffered_) {
-            if (fast5s_.empty()) { 
-                threads_[i].finished_ = true;
-            } else {
-                ReadBuffer r = fast5s_.pop_read();
-                threads_[i].next_read_.swap(r);
-                threads_[i].in_buffered_ = true;
-            }
-        }
+    if (!loading_) {
+        fast5s_.start_loading();
+        loading_ = true;
     }
 
+    std::vector<Paf> ret;
+    pafs_.pop_all(ret);
     return ret;
 }
 
+//Sleeps until a read finishes mapping or max_ms passes
+bool MapPool::wait_results(float max_ms) {
+    return results_.wait(max_ms);
+}
+
 void MapPool::add_fast5(const std::string &fast5_name) {
     fast5s_.add_fast5(fast5_name);
 }
 
+void MapPool::add_generator(const SignalGen &gen) {
+    fast5s_.add_generator(gen);
+}
 
 bool MapPool::running() {
     for (u16 i = 0; i < threads_.size(); i++) {
         if (threads_[i].running_) return true;
     }
-    return false;
+    return !pafs_.empty();
 }
 
 void MapPool::stop() {
@@ -85,9 +85,10 @@ void MapPool::stop() {
     FMProfiler prof_combined;
     #endif
 
-    //reads_.clear();
+    fast5s_.stop_loading();
+    pafs_.close();
+
     for (auto &t : threads_) {
-        t.stopped_ = true;
         t.mapper_.request_reset();
         t.thread_.join();
 
@@ -103,56 +104,45 @@ void MapPool::stop() {
 
 u16 MapPool::MapperThread::THREAD_COUNT = 0;
 
-MapPool::MapperThread::MapperThread()
+MapPool::MapperThread::MapperThread(Fast5Reader &fast5s, 
+                                    MpmcQueue<Paf> &pafs, 
+                                    Notifier &results)
     : tid_(THREAD_COUNT++),
       running_(true),
-      stopped_(false),
-      finished_(false),
-      in_buffered_(false),
-      out_buffered_(false) {
-    
-}
+      numa_(false),
+      numa_node_(0),
+      fast5s_(fast5s),
+      pafs_(pafs),
+      results_(results) {}
 
 MapPool::MapperThread::MapperThread(MapperThread &&mt) 
     : tid_(mt.tid_),
-      running_(mt.running_),
-      stopped_(mt.stopped_),                                             
-      finished_(mt.finished_),                                             
-      in_buffered_(mt.in_buffered_), 
-      out_buffered_(mt.in_buffered_), 
+      running_(mt.running_.load()),
+      numa_(mt.numa_),
+      numa_node_(mt.numa_node_),
       mapper_(),
-      thread_(std::move(mt.thread_)) {}
+      thread_(std::move(mt.thread_)),
+      fast5s_(mt.fast5s_),
+      pafs_(mt.pafs_),
+      results_(mt.results_) {}
 
 void MapPool::MapperThread::start() {
     thread_ = std::thread(&MapPool::MapperThread::run, this);
 }
 
 void MapPool::MapperThread::run() {
-    running_ = true;
-
-    while (!(finished_ || stopped_)) {
-        while (!in_buffered_ && !(stopped_ || finished_)) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        }
-
-        if (finished_ || stopped_) break;
-
-        mapper_.new_read(next_read_);
-        in_buffered_ = false;
-
-        Paf p = mapper_.map_read();
-
-        while (out_buffered_ && !stopped_) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        }
-
-        paf_out_ = p;
-        out_buffered_ = !stopped_;
+    if (numa_) {
+        Numa::pin_thread(numa_node_);
+        mapper_.use_replica(numa_node_);
     }
 
-    while (out_buffered_ && !stopped_) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ReadBuffer r;
+    while (fast5s_.next_read(r)) {
+        mapper_.new_read(r);
+        if (!pafs_.push(mapper_.map_read())) break;
+        results_.notify();
     }
 
     running_ = false;
+    results_.notify();
 }
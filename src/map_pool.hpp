@@ -28,7 +28,9 @@
 #include <vector>
 #include <deque>
 #include <unordered_set>
+#include <atomic>
 #include "conf.hpp"
+#include "mpmc_queue.hpp"
 
 class MapPool {
     public:
@@ -36,9 +38,11 @@ class MapPool {
     MapPool(Conf &conf);
 
     std::vector<Paf> update();
+    bool wait_results(float max_ms);
 
     bool running();
     void add_fast5(const std::string &fname);
+    void add_generator(const SignalGen &gen);
     void stop();
 
     #ifdef PYBIND
@@ -47,19 +51,31 @@ class MapPool {
     static void pybind_defs(pybind11::class_<MapPool> &c) {
         c.def(pybind11::init<Conf &>());
         PY_MAP_POOL_METH(update);
+        c.def("wait_results", &MapPool::wait_results, 
+              pybind11::call_guard<pybind11::gil_scoped_release>());
         PY_MAP_POOL_METH(running);
         PY_MAP_POOL_METH(add_fast5);
+        c.def("add_generator", &MapPool::add_generator,
+              pybind11::keep_alive<1, 2>());
         PY_MAP_POOL_METH(stop);
     }
 
     #endif
 
     private:
+
+    //Loads reads in background threads, shared by all mapper threads
     Fast5Reader fast5s_;
+    bool loading_;
+
+    //Mapped reads waiting to be collected by update
+    MpmcQueue<Paf> pafs_;
 
     class MapperThread {
         public:
-        MapperThread();
+        MapperThread(Fast5Reader &fast5s, 
+                     MpmcQueue<Paf> &pafs, 
+                     Notifier &results);
         MapperThread(MapperThread &&mt);
 
         void start();
@@ -69,23 +85,27 @@ class MapPool {
 
         u16 tid_;
 
-        //running: run method has not ended
-        //stopped: force stopped, like by keyboard interrupt
-        //finished: no more reads left to process
-        bool running_, stopped_, finished_, 
-             in_buffered_, out_buffered_;
+        //False once there are no more reads or the pool is stopped
+        std::atomic<bool> running_;
+
+        //If numa_ is set the thread runs on numa_node_ and maps with
+        //that node's index replica
+        bool numa_;
+        u16 numa_node_;
 
         Mapper mapper_;
         std::thread thread_;
 
-        ReadBuffer next_read_;
-        Paf paf_out_;
-
-        std::mutex in_mtx_, out_mtx_;
+        Fast5Reader &fast5s_;
+        MpmcQueue<Paf> &pafs_;
+        Notifier &results_;
     };
 
     std::vector<MapperThread> threads_;
 
+    //Signaled by mapper threads when a read finishes
+    Notifier results_;
+
 };
 
 
@@ -30,12 +30,19 @@ MapPoolOrd::MapPoolOrd(Conf &conf)
     : PRMS(conf.map_ord_prms),
       fast5s_(conf.fast5_prms),
       pool_(conf),
-      channels_empty_(false) {
+      channels_empty_(false),
+      loaded_samples_(0),
+      loading_(false),
+      stop_loading_(false) {
 
     channels_.resize(conf.get_num_channels());
     chunk_idx_.resize(conf.get_num_channels());
 }
 
+MapPoolOrd::~MapPoolOrd() {
+    stop_loading();
+}
+
 void MapPoolOrd::add_fast5(const std::string &fname) {
     fast5s_.add_fast5(fname);
 }
@@ -45,10 +52,30 @@ void MapPoolOrd::add_read(const std::string &id) {
     fast5s_.add_read(id);
 }
 
+//If max_loaded_mb is set, only read metadata is loaded here. Signal is 
+//loaded in the background by load_reads as mapping progresses
 void MapPoolOrd::load_fast5s() {
+    if (PRMS.max_loaded_mb > 0) {
+        std::cerr << "Listing reads\n";
+        load_order_ = fast5s_.list_reads();
+
+        std::cerr << "Sorting " << load_order_.size() << " reads\n";
+        pdqsort(load_order_.begin(), load_order_.end(), 
+                [](const Fast5Reader::ReadInfo &a, 
+                   const Fast5Reader::ReadInfo &b) {
+                    return a.start < b.start;
+                });
+
+        loading_ = true;
+        loader_ = std::thread(&MapPoolOrd::load_reads, this);
+        return;
+    }
+
     std::cerr << "Loading fast5s\n";
     while(!fast5s_.empty()) {
         ReadBuffer read = fast5s_.pop_read();
+        if (read.empty()) continue;
+        loaded_samples_ += read.size();
         channels_[read.get_channel_idx()].push_back(read);
     }
 
@@ -58,10 +85,51 @@ void MapPoolOrd::load_fast5s() {
     }
 }
 
+//Reads are loaded in order of start time across all channels, so each
+//channel's queue stays sorted and fast5 files are mostly read in order
+void MapPoolOrd::load_reads() {
+    u64 max_samples = (u64) PRMS.max_loaded_mb * (1 << 20) / sizeof(float);
+
+    for (const Fast5Reader::ReadInfo &info : load_order_) {
+        std::unique_lock<std::mutex> lck(load_mtx_);
+        load_cv_.wait(lck, [&] {
+            return stop_loading_ || loaded_samples_ < max_samples;
+        });
+        if (stop_loading_) break;
+        lck.unlock();
+
+        ReadBuffer read;
+        if (!fast5s_.load_read(info, read) || 
+            read.get_channel_idx() >= channels_.size()) {
+            continue;
+        }
+
+        lck.lock();
+        loaded_samples_ += read.size();
+        channels_[read.get_channel_idx()].push_back(read);
+    }
+
+    loading_ = false;
+}
+
+void MapPoolOrd::stop_loading() {
+    load_mtx_.lock();
+    stop_loading_ = true;
+    load_mtx_.unlock();
+    load_cv_.notify_all();
+
+    if (loader_.joinable()) loader_.join();
+}
+
 std::vector<Paf> MapPoolOrd::update() {
     std::vector<Paf> ret;
 
-    channels_empty_ = true;
+    //Checked before channels so reads loaded in between aren't missed
+    bool loading = loading_;
+
+    std::unique_lock<std::mutex> lck(load_mtx_);
+
+    channels_empty_ = !loading;
 
 
     for (u32 i = 0; i < channels_.size(); i++) {
@@ -94,17 +162,28 @@ std::vector<Paf> MapPoolOrd::update() {
         if (!channels_[i].empty() && 
             channels_[i].front().get_number() == nm) {
 
+                loaded_samples_ -= channels_[i].front().size();
                 channels_[i].pop_front();
                 chunk_idx_[i] = 0;
+                load_cv_.notify_one();
         }
 
         ret.push_back(std::get<2>(m));
     }
 
     //TODO: option to stop when lower than target
-    if (pool_.active_count() < PRMS.min_active_reads) {
+    //While reads are streaming in a low active count only means the loader
+    //is behind, so the cutoff waits until all reads are in channel queues
+    //and fewer than min_active_reads channels have any left
+    if (!loading && pool_.active_count() < PRMS.min_active_reads &&
+        queued_channels() < PRMS.min_active_reads) {
+        lck.unlock();
+        stop_loading();
+        lck.lock();
+
         pool_.stop_all();
         for (auto &chs : channels_) chs.clear();
+        loaded_samples_ = 0;
         channels_empty_ = true;
     }
 
@@ -112,11 +191,21 @@ std::vector<Paf> MapPoolOrd::update() {
 }
 
 
+//Number of channels with reads left to map, requires load_mtx_
+u32 MapPoolOrd::queued_channels() const {
+    u32 n = 0;
+    for (auto &ch : channels_) {
+        if (!ch.empty()) n++;
+    }
+    return n;
+}
+
 bool MapPoolOrd::running() {
     return !(channels_empty_ && pool_.all_finished());
 }
 
 void MapPoolOrd::stop() {
+    stop_loading();
     return pool_.stop_all();
 }
 
@@ -28,6 +28,9 @@
 #include <vector>
 #include <deque>
 #include <unordered_set>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include "conf.hpp"
 #include "realtime_pool.hpp"
 #include "fast5_reader.hpp"
@@ -38,6 +41,7 @@ class MapPoolOrd {
     MapOrdParams PRMS;
 
     MapPoolOrd(Conf &conf);
+    ~MapPoolOrd();
 
     void add_fast5(const std::string &fname);
     void add_read(const std::string &id);
@@ -48,6 +52,12 @@ class MapPoolOrd {
     bool running();
 
     private:
+
+    //Loads reads in order of start time while under max_loaded_mb
+    void load_reads();
+    void stop_loading();
+    u32 queued_channels() const;
+
     Fast5Reader fast5s_;
     RealtimePool pool_;
 
@@ -58,6 +68,15 @@ class MapPoolOrd {
     std::vector<u32> chunk_idx_;
 
     bool channels_empty_;
+
+    //Streaming mode. load_mtx_ guards channels_ and loaded_samples_
+    std::vector<Fast5Reader::ReadInfo> load_order_;
+    std::thread loader_;
+    std::mutex load_mtx_;
+    std::condition_variable load_cv_;
+    u64 loaded_samples_;
+    std::atomic<bool> loading_;
+    bool stop_loading_;
 };
 
 
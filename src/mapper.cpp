@@ -23,9 +23,16 @@
 
 #include <pdqsort.h>
 #include <exception>
+#include <thread>
+#include <chrono>
 #include "mapper.hpp"
 #include "model_r94.inl"
 
+static inline i64 steady_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 Mapper::Params Mapper::PRMS {
     seed_len        : 22,
     min_rep_len     : 0,
@@ -52,7 +59,10 @@ Mapper::Params Mapper::PRMS {
 };
 
 BwaIndex<KLEN> Mapper::fmi;
+std::vector< BwaIndex<KLEN> > Mapper::fmi_replicas_;
+u16 Mapper::fmi_node_ = 0;
 std::vector<float> Mapper::prob_threshes_;
+std::vector<std::string> Mapper::ref_names_;
 
 PoreModel<KLEN> Mapper::model = pmodel_r94_complement;
 
@@ -64,10 +74,19 @@ u32 Mapper::PATH_MASK = 0;
 u32 Mapper::PATH_TAIL_MOVE = 0;
 
 Mapper::Mapper() :
+    fmi_(&fmi),
     evdt_(PRMS.event_prms),
     evt_prof_(PRMS.evt_prof_prms),
     seed_tracker_(PRMS.seed_prms),
-    state_(State::INACTIVE) {
+    reset_(false),
+    queue_events_(false),
+    state_(State::INACTIVE),
+    arena_(NULL),
+    raw_queue_(2 * ReadBuffer::PRMS.chunk_len()),
+    pending_since_(0),
+    raw_len_(0),
+    chunk_processed_(true),
+    mean_evt_len_(0) {
 
     load_static();
 
@@ -76,18 +95,9 @@ Mapper::Mapper() :
     }
     PATH_TAIL_MOVE = 1 << (PRMS.seed_len-1);
 
-    kmer_probs_ = std::vector<float>(kmer_count<KLEN>());
-
-    PathBuffer::reset_count();//TODO is there a better way?
-    prev_paths_ = std::vector<PathBuffer>(PRMS.max_paths);
-
-    PathBuffer::reset_count();
-    next_paths_ = std::vector<PathBuffer>(PRMS.max_paths);
-
-    sources_added_ = std::vector<bool>(kmer_count<KLEN>(), false);
-
     prev_size_ = 0;
     event_i_ = 0;
+    chunk_i_ = 0;
     seed_tracker_.reset();
 
     norm_.set_target(model.get_means_mean(), model.get_means_stdv());
@@ -97,13 +107,73 @@ Mapper::Mapper(const Mapper &m) : Mapper() {}
 
 Mapper::~Mapper() {
     dbg_close_all();
+}
+
+Mapper::PathArena::PathArena() 
+    : prob_sums_(2 * PRMS.max_paths * (PRMS.seed_len+1)),
+      kmer_probs_(kmer_count<KLEN>()),
+      sources_added_(kmer_count<KLEN>(), false),
+      owner_(NULL) {
+
+    PathBuffer::reset_count();//TODO is there a better way?
+    prev_paths_ = std::vector<PathBuffer>(PRMS.max_paths);
+
+    PathBuffer::reset_count();
+    next_paths_ = std::vector<PathBuffer>(PRMS.max_paths);
+
+    float *sums = prob_sums_.data();
+    for (u32 i = 0; i < PRMS.max_paths; i++) {
+        prev_paths_[i].prob_sums_ = sums;
+        sums += PRMS.seed_len+1;
+        next_paths_[i].prob_sums_ = sums;
+        sums += PRMS.seed_len+1;
+    }
+}
+
+//Copies the paths of the current read into the arena, unless they're
+//already there because the arena was last used by this mapper
+void Mapper::load_paths(PathArena &arena) {
+    arena_ = &arena;
+
+    if (arena.owner_ == this) return;
+
+    if (arena.owner_ != NULL) {
+        arena.owner_->save_paths();
+    }
+    arena.owner_ = this;
+
+    u32 sums_len = PRMS.seed_len+1;
+    for (u32 i = 0; i < prev_size_; i++) {
+        PathBuffer &p = arena.prev_paths_[i];
+        float *sums = p.prob_sums_;
+        p = frontier_[i];
+        p.prob_sums_ = sums;
+        std::memcpy(sums, &frontier_probs_[i*sums_len], 
+                    (p.length_+1) * sizeof(float));
+    }
+}
+
+//Copies paths out of the arena so another read can use it
+void Mapper::save_paths() {
+    auto &paths = arena_->prev_paths_;
+    frontier_.assign(paths.begin(), paths.begin() + prev_size_);
 
-    for (u32 i = 0; i < next_paths_.size(); i++) {
-        next_paths_[i].free_buffers();
-        prev_paths_[i].free_buffers();
+    u32 sums_len = PRMS.seed_len+1;
+    frontier_probs_.resize(prev_size_ * sums_len);
+    for (u32 i = 0; i < prev_size_; i++) {
+        std::memcpy(&frontier_probs_[i*sums_len], paths[i].prob_sums_, 
+                    (paths[i].length_+1) * sizeof(float));
     }
 }
 
+void Mapper::unload_paths(PathArena &arena) {
+    if (arena.owner_ != this) return;
+
+    //Paths of a finished read are never used again
+    if (!finished()) save_paths();
+    arena.owner_ = NULL;
+}
+
 
 void Mapper::load_static() {
 
@@ -114,6 +184,11 @@ void Mapper::load_static() {
         std::cerr << "Error: failed to load BWA index\n";
         abort();
     }
+    fmi_node_ = Numa::current_node();
+
+    for (auto &seq : fmi.get_seqs()) {
+        ref_names_.push_back(seq.first);
+    }
 
     std::ifstream param_file(PRMS.bwa_prefix + INDEX_SUFF);
     if (!param_file.is_open()) {
@@ -153,6 +228,38 @@ void Mapper::load_static() {
 
 }
 
+//Loads a copy of the index for each NUMA node other than the one fmi was
+//loaded on. Each copy is read by a thread pinned to its node, so its
+//pages are allocated in that node's memory
+void Mapper::load_replicas() {
+    if (!fmi_replicas_.empty()) return;
+
+    fmi_replicas_.resize(Numa::node_count());
+    if (fmi_replicas_.size() < 2) return;
+
+    std::vector<std::thread> loaders;
+    for (u16 node = 0; node < fmi_replicas_.size(); node++) {
+        if (node == fmi_node_) continue;
+
+        loaders.emplace_back([node] {
+            Numa::pin_thread(node);
+            fmi_replicas_[node].load_index(PRMS.bwa_prefix);
+        });
+    }
+
+    for (std::thread &t : loaders) {
+        t.join();
+    }
+}
+
+void Mapper::use_replica(u16 node) {
+    if (node < fmi_replicas_.size() && fmi_replicas_[node].is_loaded()) {
+        fmi_ = &fmi_replicas_[node];
+    } else {
+        fmi_ = &fmi;
+    }
+}
+
 inline u64 Mapper::get_fm_bin(u64 fmlen) {
     return __builtin_clzll(fmlen);
 }
@@ -185,9 +292,24 @@ Paf Mapper::map_read() {
 
     map_timer_.reset();
 
-    norm_.set_signal(evdt_.get_means(read_.full_signal_));
+    //Events are detected lazily, at most evt_buffer_len ahead of the mapper
+    //Normalization is based on the buffered prefix of the read (rolling
+    //once full), so detection stops as soon as the read is mapped
+    norm_.reset(PRMS.evt_buffer_len);
+
+    const std::vector<float> &raw = read_.full_signal_;
+    u32 raw_i = 0;
 
-    while (!map_next()) {}
+    if (!own_arena_) own_arena_.reset(new PathArena());
+    load_paths(*own_arena_);
+
+    do {
+        while (!norm_.full() && raw_i < raw.size()) {
+            if (evdt_.add_sample(raw[raw_i++])) {
+                norm_.push(evdt_.get_mean());
+            }
+        }
+    } while (!map_next());
 
     read_.loc_.set_float(Paf::Tag::MAP_TIME, map_timer_.get());
 
@@ -198,6 +320,8 @@ void Mapper::new_read(ReadBuffer &r) {
     read_.clear();//TODO: probably shouldn't auto erase previous read
     read_.swap(r);
     reset();
+    raw_len_ = read_.raw_len_;
+    chunk_processed_ = read_.chunk_processed_;
     dbg_open_all();
 }
 
@@ -207,17 +331,32 @@ void Mapper::new_read(Chunk &chunk) {
         std::cerr << "Error: possibly lost read '" << read_.id_ << "'\n";
     }
 
+    //Signal thread may still be processing the previous read
+    chunk_mtx_.lock();
     read_ = ReadBuffer(chunk);
     reset();
+    raw_len_ = read_.raw_len_;
+    chunk_processed_ = read_.chunk_processed_;
+    pending_since_.store(steady_ns());
+    chunk_mtx_.unlock();
+}
+
+void Mapper::use_event_queue() {
+    evt_queue_.resize(PRMS.evt_buffer_len);
+    queue_events_ = true;
 }
 
 void Mapper::reset() {
     prev_size_ = 0;
     event_i_ = 0;
+    chunk_i_ = 0;
     reset_ = false;
     last_chunk_ = false;
+    queue_timed_ = false;
     state_ = State::MAPPING;
     norm_.skip_unread();
+    raw_queue_.clear();
+    evt_queue_.clear();
 
     seed_tracker_.reset();
     evdt_.reset();
@@ -227,6 +366,7 @@ void Mapper::reset() {
     map_timer_.reset();
     map_time_ = 0;
     wait_time_ = 0;
+    pending_since_.store(0);
 
     dbg_close_all();
 
@@ -265,7 +405,7 @@ bool Mapper::is_resetting() {
 }
 
 bool Mapper::is_chunk_processed() const {
-    return read_.chunk_processed_;
+    return chunk_processed_ && raw_queue_.empty();
 }
 
 Mapper::State Mapper::get_state() const {
@@ -273,14 +413,12 @@ Mapper::State Mapper::get_state() const {
 }
 
 bool Mapper::add_chunk(Chunk &chunk) {
-    if (!chunk_mtx_.try_lock()) return false;
+    if (finished() || reset_ ||
+        read_.channel_idx_ != chunk.get_channel_idx() || 
+        read_.number_ != chunk.get_number()) return false;
 
-    if (!is_chunk_processed() || finished() || reset_) { 
-        chunk_mtx_.unlock();
-        return false;
-    }
-
-    if (read_.chunks_maxed()) {
+    if (chunks_maxed()) {
+        if (!is_chunk_processed() || !chunk_mtx_.try_lock()) return false;
 
         set_failed();
         chunk.clear();
@@ -289,29 +427,59 @@ bool Mapper::add_chunk(Chunk &chunk) {
         return true;
     }
 
-    bool added = read_.add_chunk(chunk);
-    if (added) {
+    if (!chunk_mtx_.try_lock()) return false;
+
+    //Pass as much signal as fits, any remainder stays in the chunk
+    u32 n = raw_queue_.push(chunk.get_raw_data().data(), chunk.size());
+    if (n > 0) {
+        raw_len_ += n;
+        chunk.skip(n);
         chunk_timer_.reset();
+        if (pending_since_.load() == 0) pending_since_.store(steady_ns());
     }
 
     chunk_mtx_.unlock();
-    return added;
+    return chunk.empty();
 }
 
 u16 Mapper::process_chunk() {
-    if (read_.chunk_processed_ || reset_ || 
-        !chunk_mtx_.try_lock()) return 0; 
+    if (reset_ || !chunk_mtx_.try_lock()) return 0; 
+
+    //Take any signal received since the last chunk was finished
+    if (chunk_i_ >= read_.chunk_.size() && !raw_queue_.empty()) {
+        chunk_processed_ = false;
+        read_.chunk_.clear();
+        chunk_i_ = 0;
+        raw_queue_.pop_all(read_.chunk_);
+    }
 
-    if (read_.chunk_count() == 1) {
-        dbg_open_all();
-        read_.loc_.set_float(Paf::Tag::QUEUE_TIME, map_timer_.lap());
+    if (chunk_processed_) {
+        chunk_mtx_.unlock();
+        return 0;
     }
 
-    wait_time_ += map_timer_.lap();
+    //Timers and tags belong to the mapping thread when queueing events
+    if (!queue_events_) {
+        if (!queue_timed_) {
+            dbg_open_all();
+            read_.loc_.set_float(Paf::Tag::QUEUE_TIME, map_timer_.lap());
+            queue_timed_ = true;
+        }
+
+        wait_time_ += map_timer_.lap();
+    }
 
     u16 nevents = 0;
-    for (u32 i = 0; i < read_.chunk_.size(); i++) {
-        if (evdt_.add_sample(read_.chunk_[i])) {
+    while (chunk_i_ < read_.chunk_.size()) {
+
+        //Normalizer window is full and the mapping thread is behind,
+        //resume from here once it catches up
+        if (queue_events_ && norm_.full() && !queue_normalized()) {
+            chunk_mtx_.unlock();
+            return nevents;
+        }
+
+        if (evdt_.add_sample(read_.chunk_[chunk_i_++])) {
 
             //Add event to profiler
             //Returns true if next event is not masked
@@ -327,6 +495,15 @@ u16 Mapper::process_chunk() {
 
             auto evt_mean = evt_prof_.next_mean();
 
+            //Queued once the whole chunk is in the normalizer, so events
+            //are scaled by the same statistics as when not queueing
+            if (queue_events_) {
+                norm_.push(evt_mean);
+                mean_evt_len_ = evdt_.mean_event_len();
+                nevents++;
+                continue;
+            }
+
             if (!norm_.push(evt_mean)) {
 
                 u32 nskip = norm_.skip_unread(nevents);
@@ -348,19 +525,46 @@ u16 Mapper::process_chunk() {
         }
     }
 
+    if (queue_events_ && !queue_normalized()) {
+        chunk_mtx_.unlock();
+        return nevents;
+    }
+
     dbg_events_out();
 
     read_.chunk_.clear();
+    chunk_i_ = 0;
 
-    read_.chunk_processed_ = true;
+    chunk_processed_ = true;
 
-    map_time_ += map_timer_.lap();
+    if (!queue_events_) {
+        map_time_ += map_timer_.lap();
+    }
 
     chunk_mtx_.unlock();
     return nevents;
 }
 
+//Moves normalized events to the event queue until it fills
+//Returns true if all were moved
+bool Mapper::queue_normalized() {
+    while (!norm_.empty()) {
+        if (evt_queue_.full()) return false;
+        evt_queue_.push(norm_.pop());
+    }
+    return true;
+}
+
+u32 Mapper::get_chunk_count() const {
+    return raw_len_ / ReadBuffer::PRMS.chunk_len();
+}
+
+bool Mapper::chunks_maxed() const {
+    return get_chunk_count() >= ReadBuffer::PRMS.max_chunks;
+}
+
 void Mapper::set_failed() {
+    read_.set_raw_len(raw_len_);
     state_ = State::FAILURE;
     reset_ = false;
 
@@ -369,10 +573,34 @@ void Mapper::set_failed() {
 }
 
 bool Mapper::chunk_mapped() {
-    return read_.chunk_processed_ && norm_.empty();
+    return is_chunk_processed() && events_empty();
+}
+
+bool Mapper::events_empty() const {
+    if (queue_events_) return evt_queue_.empty();
+    return norm_.empty();
 }
 
-bool Mapper::map_chunk() {
+float Mapper::pop_event() {
+    if (!queue_events_) return norm_.pop();
+
+    float e = 0;
+    evt_queue_.pop(e);
+    return e;
+}
+
+void Mapper::clear_events() {
+    if (queue_events_) evt_queue_.clear();
+    else norm_.skip_unread();
+}
+
+bool Mapper::map_chunk(PathArena &arena) {
+    if (queue_events_ && !queue_timed_) {
+        dbg_open_all();
+        read_.loc_.set_float(Paf::Tag::QUEUE_TIME, map_timer_.lap());
+        queue_timed_ = true;
+    }
+
     wait_time_ += map_timer_.lap();
 
     if (reset_ || chunk_timer_.get() > PRMS.chunk_timeout) {
@@ -381,13 +609,13 @@ bool Mapper::map_chunk() {
         //std::cerr << "# END timer or reset\n";
         return true;
 
-    } else if (norm_.empty() && 
-               read_.chunk_processed_ && 
-               read_.chunks_maxed()) {
+    } else if (events_empty() && 
+               is_chunk_processed() && 
+               chunks_maxed()) {
 
         chunk_mtx_.lock();
 
-        if (norm_.empty() && read_.chunk_processed_) {
+        if (events_empty() && is_chunk_processed()) {
             set_failed();
             chunk_mtx_.unlock();
             return true;
@@ -396,7 +624,8 @@ bool Mapper::map_chunk() {
         chunk_mtx_.unlock();
     }
 
-    if (norm_.empty()) {
+    if (events_empty()) {
+        update_pending();
         return false;
     }
 
@@ -404,11 +633,13 @@ bool Mapper::map_chunk() {
     u16 nevents = get_max_events();
     float tlimit = PRMS.evt_timeout * nevents;
 
-    for (u16 i = 0; i < nevents && !norm_.empty(); i++) {
+    load_paths(arena);
+
+    for (u16 i = 0; i < nevents && !events_empty(); i++) {
         if (map_next()) {
             read_.loc_.set_float(Paf::Tag::MAP_TIME, map_time_+map_timer_.get());
             read_.loc_.set_float(Paf::Tag::WAIT_TIME, wait_time_);
-            norm_.skip_unread();
+            clear_events();
             return true;
         }
 
@@ -422,18 +653,40 @@ bool Mapper::map_chunk() {
     return false;
 }
 
+//Clears the pending time once all received signal has been mapped
+void Mapper::update_pending() {
+    if (pending_since_.load() == 0 || !chunk_mtx_.try_lock()) return;
+    if (is_chunk_processed() && events_empty()) pending_since_.store(0);
+    chunk_mtx_.unlock();
+}
+
+bool Mapper::signal_mapped() const {
+    return pending_since_.load() == 0;
+}
+
+float Mapper::get_pending_age() const {
+    i64 t = pending_since_.load();
+    if (t == 0) return 0;
+    return (steady_ns() - t) / 1000000.0;
+}
+
 bool Mapper::map_next() {
-    if (norm_.empty() || reset_ || event_i_ >= PRMS.max_events) {
+    if (events_empty() || reset_ || event_i_ >= PRMS.max_events) {
         state_ = State::FAILURE;
         return true;
     }
 
 
-    float event = norm_.pop();
+    float event = pop_event();
+
+    std::vector<PathBuffer> &prev_paths = arena_->prev_paths_,
+                            &next_paths = arena_->next_paths_;
+    std::vector<float> &kmer_probs = arena_->kmer_probs_;
+    std::vector<bool> &sources_added = arena_->sources_added_;
 
-    //TODO: store kmer_probs_ in static array
-    for (u16 kmer = 0; kmer < kmer_probs_.size(); kmer++) {
-        kmer_probs_[kmer] = model.match_prob(event, kmer);
+    //TODO: store kmer_probs in static array
+    for (u16 kmer = 0; kmer < kmer_probs.size(); kmer++) {
+        kmer_probs[kmer] = model.match_prob(event, kmer);
     }
 
     Range prev_range;
@@ -441,17 +694,17 @@ bool Mapper::map_next() {
     float evpr_thresh;
     bool child_found;
 
-    auto next_path = next_paths_.begin();
+    auto next_path = next_paths.begin();
 
     //Find neighbors of previous nodes
     for (u32 pi = 0; pi < prev_size_; pi++) {
-        if (!prev_paths_[pi].is_valid()) {
+        if (!prev_paths[pi].is_valid()) {
             continue;
         }
 
         child_found = false;
 
-        PathBuffer &prev_path = prev_paths_[pi];
+        PathBuffer &prev_path = prev_paths[pi];
         Range &prev_range = prev_path.fm_range_;
         prev_kmer = prev_path.kmer_;
 
@@ -460,16 +713,16 @@ bool Mapper::map_next() {
         //evpr_thresh = PRMS.get_path_thresh(prev_path.total_move_len_);
 
         if (prev_path.consec_stays_ < PRMS.max_consec_stay && 
-            kmer_probs_[prev_kmer] >= evpr_thresh) {
+            kmer_probs[prev_kmer] >= evpr_thresh) {
 
             next_path->make_child(prev_path, 
                                   prev_range,
                                   prev_kmer, 
-                                  kmer_probs_[prev_kmer], 
+                                  kmer_probs[prev_kmer], 
                                   EVENT_STAY);
             child_found = true;
 
-            if (++next_path == next_paths_.end()) {
+            if (++next_path == next_paths.end()) {
                 break;
             }
         }
@@ -478,11 +731,11 @@ bool Mapper::map_next() {
         for (u8 b = 0; b < BASE_COUNT; b++) {
             u16 next_kmer = kmer_neighbor<KLEN>(prev_kmer, b);
 
-            if (kmer_probs_[next_kmer] < evpr_thresh) {
+            if (kmer_probs[next_kmer] < evpr_thresh) {
                 continue;
             }
 
-            Range next_range = fmi.get_neighbor(prev_range, b);
+            Range next_range = fmi_->get_neighbor(prev_range, b);
 
             if (!next_range.is_valid()) {
                 continue;
@@ -491,12 +744,12 @@ bool Mapper::map_next() {
             next_path->make_child(prev_path, 
                                   next_range,
                                   next_kmer, 
-                                  kmer_probs_[next_kmer], 
+                                  kmer_probs[next_kmer], 
                                   EVENT_MOVE);
 
             child_found = true;
 
-            if (++next_path == next_paths_.end()) {
+            if (++next_path == next_paths.end()) {
                 break;
             }
         }
@@ -510,73 +763,73 @@ bool Mapper::map_next() {
 
         }
 
-        if (next_path == next_paths_.end()) {
+        if (next_path == next_paths.end()) {
             break;
         }
     }
 
     //Create sources between gaps
-    if (next_path != next_paths_.begin()) {
+    if (next_path != next_paths.begin()) {
 
-        u32 next_size = next_path - next_paths_.begin();
+        u32 next_size = next_path - next_paths.begin();
 
-        pdqsort(next_paths_.begin(), next_path);
-        //std::sort(next_paths_.begin(), next_path);
+        pdqsort(next_paths.begin(), next_path);
+        //std::sort(next_paths.begin(), next_path);
 
         u16 source_kmer;
-        prev_kmer = kmer_probs_.size(); 
+        prev_kmer = kmer_probs.size(); 
 
         Range unchecked_range, source_range;
 
         for (u32 i = 0; i < next_size; i++) {
-            source_kmer = next_paths_[i].kmer_;
+            source_kmer = next_paths[i].kmer_;
 
             //Add source for beginning of kmer range
             if (source_kmer != prev_kmer &&
-                next_path != next_paths_.end() &&
-                kmer_probs_[source_kmer] >= get_source_prob()) {
+                next_path != next_paths.end() &&
+                kmer_probs[source_kmer] >= get_source_prob()) {
 
-                sources_added_[source_kmer] = true;
+                sources_added[source_kmer] = true;
 
-                source_range = Range(fmi.get_kmer_range(source_kmer).start_,
-                                     next_paths_[i].fm_range_.start_ - 1);
+                source_range = Range(fmi_->get_kmer_range(source_kmer).start_,
+                                     next_paths[i].fm_range_.start_ - 1);
 
                 if (source_range.is_valid()) {
                     next_path->make_source(source_range,
                                            source_kmer,
-                                           kmer_probs_[source_kmer]);
+                                           kmer_probs[source_kmer]);
                     next_path++;
                 }                                    
 
-                unchecked_range = Range(next_paths_[i].fm_range_.end_ + 1,
-                                        fmi.get_kmer_range(source_kmer).end_);
+                unchecked_range = Range(next_paths[i].fm_range_.end_ + 1,
+                                        fmi_->get_kmer_range(source_kmer).end_);
             }
 
             prev_kmer = source_kmer;
 
-            //Range next_range = next_paths_[i].fm_range_;
+            //Range next_range = next_paths[i].fm_range_;
 
             //Remove paths with duplicate ranges
             //Best path will be listed last
-            if (i < next_size - 1 && next_paths_[i].fm_range_ == next_paths_[i+1].fm_range_) {
-                next_paths_[i].invalidate();
+            if (i < next_size - 1 && next_paths[i].fm_range_ == next_paths[i+1].fm_range_) {
+                next_paths[i].invalidate();
                 continue;
             }
 
             //Start source after current path
             //TODO: check if theres space for a source here, instead of after extra work?
-            if (next_path != next_paths_.end() &&
-                kmer_probs_[source_kmer] >= get_source_prob()) {
+            if (next_path != next_paths.end() &&
+                kmer_probs[source_kmer] >= get_source_prob()) {
                 
                 source_range = unchecked_range;
                 
                 //Between this and next path ranges
-                if (i < next_size - 1 && source_kmer == next_paths_[i+1].kmer_) {
+                if (i < next_size - 1 && source_kmer == next_paths[i+1].kmer_) {
 
-                    source_range.end_ = next_paths_[i+1].fm_range_.start_ - 1;
+                    source_range.end_ = next_paths[i+1].fm_range_.start_ - 1;
 
-                    if (unchecked_range.start_ <= next_paths_[i+1].fm_range_.end_) {
-                        unchecked_range.start_ = next_paths_[i+1].fm_range_.end_ + 1;
+                    if (unchecked_range.start_ <= next_paths[i+1].fm_range_.end_) {
+                        unchecked_range.start_ = next_paths[i+1].fm_range_.end_ + 1;
                     }
                 }
 
@@ -585,38 +838,38 @@ bool Mapper::map_next() {
 
                     next_path->make_source(source_range,
                                            source_kmer,
-                                           kmer_probs_[source_kmer]);
+                                           kmer_probs[source_kmer]);
                     next_path++;
                 }
             }
 
-            update_seeds(next_paths_[i], false);
+            update_seeds(next_paths[i], false);
         }
     }
 
     for (u16 kmer = 0; 
-         kmer < kmer_probs_.size() && 
-            next_path != next_paths_.end(); 
+         kmer < kmer_probs.size() && 
+            next_path != next_paths.end(); 
          kmer++) {
 
-        Range next_range = fmi.get_kmer_range(kmer);
+        Range next_range = fmi_->get_kmer_range(kmer);
 
-        if (!sources_added_[kmer] && 
-            kmer_probs_[kmer] >= get_source_prob() &&
-            next_path != next_paths_.end() &&
+        if (!sources_added[kmer] && 
+            kmer_probs[kmer] >= get_source_prob() &&
+            next_path != next_paths.end() &&
             next_range.is_valid()) {
 
             //TODO: don't write to prob buffer here to speed up source loop
-            next_path->make_source(next_range, kmer, kmer_probs_[kmer]);
+            next_path->make_source(next_range, kmer, kmer_probs[kmer]);
             next_path++;
 
         } else {
-            sources_added_[kmer] = false;
+            sources_added[kmer] = false;
         }
     }
 
-    prev_size_ = next_path - next_paths_.begin();
-    prev_paths_.swap(next_paths_);
+    prev_size_ = next_path - next_paths.begin();
+    prev_paths.swap(next_paths);
 
     dbg_paths_out();
 
@@ -667,7 +920,7 @@ void Mapper::update_seeds(PathBuffer &path, bool path_ended) {
         //TODO: store in buffer, replace sa_checked
         //
         //Reverse the reference coords so they both go L->R
-        u64 sa_end = fmi.size() - fmi.sa(s);
+        u64 sa_end = fmi_->size() - fmi_->sa(s);
 
         u32 ref_len = path.move_count() + KLEN - 1;
         u64 sa_start = sa_end - ref_len + 1;
@@ -694,28 +947,31 @@ void Mapper::update_seeds(PathBuffer &path, bool path_ended) {
 
 u32 Mapper::event_to_bp(u32 evt_i, bool last) const {
     //TODO store bp_per_samp
-    return (evt_i * evdt_.mean_event_len() * ReadBuffer::PRMS.bp_per_samp()) + last*(KLEN - 1);
+    float evt_len = queue_events_ ? mean_evt_len_.load() 
+                                  : evdt_.mean_event_len();
+    return (evt_i * evt_len * ReadBuffer::PRMS.bp_per_samp()) + last*(KLEN - 1);
 }                  
 
 void Mapper::set_ref_loc(const SeedCluster &seeds) {
-    bool fwd = seeds.ref_st_ < fmi.size() / 2;
+    bool fwd = seeds.ref_st_ < fmi_->size() / 2;
 
     u64 sa_st;
     if (fwd) sa_st = seeds.ref_st_;
-    else      sa_st = fmi.size() - (seeds.ref_en_.end_ + KLEN - 1);
+    else      sa_st = fmi_->size() - (seeds.ref_en_.end_ + KLEN - 1);
     
-    std::string rf_name;
+    i32 rf_id = 0;
     u64 rd_st = event_to_bp(seeds.evt_st_ - PRMS.seed_len),
         rd_en = event_to_bp(seeds.evt_en_, true),
         rd_len = event_to_bp(event_i_, true),
         rf_st = 0,
-        rf_len = fmi.translate_loc(sa_st, rf_name, rf_st), //sets rf_st
+        rf_len = fmi_->get_ref_loc(sa_st, rf_id, rf_st), //sets rf_id, rf_st
         rf_en = rf_st + (seeds.ref_en_.end_ - seeds.ref_st_ + KLEN);
 
     u16 match_count = seeds.total_len_ + KLEN - 1;
 
+    read_.set_raw_len(raw_len_);
     read_.loc_.set_read_len(rd_len);
-    read_.loc_.set_mapped(rd_st, rd_en, rf_name, rf_st, rf_en, rf_len, fwd, match_count);
+    read_.loc_.set_mapped(rd_st, rd_en, ref_names_, rf_id, rf_st, rf_en, rf_len, fwd, match_count);
 
 }
 
@@ -725,7 +981,7 @@ u32 Mapper::PathBuffer::count_ = 0;
 
 Mapper::PathBuffer::PathBuffer()
     : length_(0),
-      prob_sums_(new float[PRMS.seed_len+1]) {
+      prob_sums_(NULL) {
 
     #ifdef DEBUG_OUT
     id_ = count_++;
@@ -736,10 +992,6 @@ Mapper::PathBuffer::PathBuffer(const PathBuffer &p) {
     std::memcpy(this, &p, sizeof(PathBuffer));
 }
 
-void Mapper::PathBuffer::free_buffers() {
-    delete[] prob_sums_;
-}
-
 void Mapper::PathBuffer::make_source(Range &range, u16 kmer, float prob) {
     length_ = 1;
     consec_stays_ = 0;
@@ -993,19 +1245,19 @@ void Mapper::dbg_seeds_out(
     
     //TODO clearly deliniate fm_coord, sa_coord(fw/rv), pacseq_coord, ann_coord
 
-    bool fwd = sa_start < (fmi.size() / 2);
+    bool fwd = sa_start < (fmi_->size() / 2);
 
     //TODO change sa_ to clarify unstranded
     u32 sa_half;
     if (fwd) {
         sa_half = sa_start;
     } else {
-        sa_half = fmi.size() - (sa_start + ref_len - 1);
+        sa_half = fmi_->size() - (sa_start + ref_len - 1);
     }
 
     std::string rf_name;
     u64 ref_st = 0;
-    fmi.translate_loc(sa_half, rf_name, ref_st);
+    fmi_->translate_loc(sa_half, rf_name, ref_st);
 
     if (ref_st == 0) {
         std::cerr << rf_name << "\t"
@@ -1034,7 +1286,7 @@ void Mapper::dbg_seeds_out(
 void Mapper::dbg_paths_out() {
     #ifdef DEBUG_PATHS
     for (u32 i = 0; i < prev_size_; i++) {
-        auto &p = prev_paths_[i];
+        auto &p = arena_->prev_paths_[i];
 
         u32 evt = evt_prof_.mask_idx_map_[event_i_];
 
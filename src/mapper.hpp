@@ -26,6 +26,8 @@
 
 #include <iostream>
 #include <vector>
+#include <memory>
+#include <atomic>
 #include "bwa_index.hpp"
 #include "normalizer.hpp"
 #include "event_detector.hpp"
@@ -33,6 +35,8 @@
 #include "pore_model.hpp"
 #include "seed_tracker.hpp"
 #include "read_buffer.hpp"
+#include "spsc_queue.hpp"
+#include "numa.hpp"
 
 const KmerLen KLEN = KmerLen::k5;
 
@@ -84,11 +88,22 @@ class Mapper {
     static PoreModel<KLEN> model;
     static std::vector<float> prob_threshes_;
 
+    //Reference sequence names, indexed by the PAF reference IDs
+    static std::vector<std::string> ref_names_;
+
     static void load_static();
     static inline u64 get_fm_bin(u64 fmlen);
 
+    //Per-NUMA node copies of fmi, see load_replicas
+    static std::vector< BwaIndex<KLEN> > fmi_replicas_;
+    static u16 fmi_node_;
+    static void load_replicas();
+
     enum class State { INACTIVE, MAPPING, SUCCESS, FAILURE };
 
+    //Search buffers shared by all mappers run by one thread
+    class PathArena;
+
     Mapper();
     Mapper(const Mapper &m);
 
@@ -98,12 +113,20 @@ class Mapper {
     float get_source_prob() const;
     u16 get_max_events() const;
 
+    //Maps with the index replica local to a NUMA node
+    void use_replica(u16 node);
+
     void new_read(ReadBuffer &r);
     void new_read(Chunk &c);
     void reset();
     void set_failed();
 
     Paf map_read();
+    bool map_chunk(PathArena &arena);
+
+    //Copies the read's paths out of the arena if they're still there, so
+    //the mapper can be passed to another thread
+    void unload_paths(PathArena &arena);
 
     void skip_events(u32 n);
     bool add_chunk(Chunk &chunk);
@@ -112,15 +135,30 @@ class Mapper {
 
     u32 events_mapped() const {return event_i_;}
 
+    //Used to prioritize channels in realtime mode
+    //Milliseconds since the oldest unmapped signal was received, 0 if none
+    float get_pending_age() const;
+
+    //True once the mapping thread has mapped all signal received so far
+    bool signal_mapped() const;
+    float get_seed_progress() {return seed_tracker_.get_progress();}
+
+    //Chunks of signal received for the current read
+    u32 get_chunk_count() const;
+    bool chunks_maxed() const;
+
     u16 process_chunk();
     bool chunk_mapped();
-    bool map_chunk();
     bool is_chunk_processed() const;
     void request_reset();
     void end_reset();
     bool is_resetting();
     State get_state() const;
 
+    //Normalized events are passed from process_chunk to map_chunk through
+    //a lock-free queue, so they can be called from different threads
+    void use_event_queue();
+
     u32 prev_unfinished(u32 next_number) const;
 
     bool finished() const;
@@ -163,7 +201,6 @@ class Mapper {
 
         float prob_head() const;
 
-        void free_buffers();
         void print() const;
 
         Range fm_range_;
@@ -197,15 +234,46 @@ class Mapper {
 
     friend bool operator< (const PathBuffer &p1, const PathBuffer &p2);
 
+    public:
+
+    //Path buffers and per-event scratch space are only needed while
+    //events are being mapped, so they are allocated once per thread
+    //instead of once per channel. Path probabilities are stored in one
+    //block rather than allocated per path
+    class PathArena {
+        public:
+        PathArena();
+        PathArena(const PathArena &a) = delete;
+        PathArena(PathArena &&a) = default;
+
+        private:
+        friend class Mapper;
+
+        std::vector<PathBuffer> prev_paths_, next_paths_;
+        std::vector<float> prob_sums_, kmer_probs_;
+        std::vector<bool> sources_added_;
+
+        //Mapper whose paths are in prev_paths_, NULL if none. Its paths
+        //are only copied out when another mapper needs the arena
+        Mapper *owner_;
+    };
+
     private:
 
     bool map_next();
 
+    void load_paths(PathArena &arena);
+    void save_paths();
+
     void update_seeds(PathBuffer &p, bool has_children);
 
     void set_ref_loc(const SeedCluster &seeds);
 
+    bool events_empty() const;
+    float pop_event();
+    void clear_events();
 
+    BwaIndex<KLEN> *fmi_;
     EventDetector evdt_;
     EventProfiler evt_prof_;
     Normalizer norm_;
@@ -214,17 +282,48 @@ class Mapper {
 
     //u16 channel_;
     //u32 read_num_;
-    bool last_chunk_, reset_;//, processing_, adding_;
-    State state_;
-    std::vector<float> kmer_probs_;
-    std::vector<PathBuffer> prev_paths_, next_paths_;
-    std::vector<bool> sources_added_;
+    bool last_chunk_;//, processing_, adding_;
+
+    //Set by the pool update thread to end the read early
+    std::atomic<bool> reset_;
+    bool queue_events_, queue_timed_;
+    //Also read by signal threads and the pool update thread
+    std::atomic<State> state_;
+
+    //Arena used by the current map_chunk or map_read call
+    PathArena *arena_;
+
+    //Used by map_read if the mapper isn't run by a thread with an arena
+    std::unique_ptr<PathArena> own_arena_;
+
+    //Paths of the current read kept while another mapper uses the arena,
+    //grown as needed. Probabilities are seed_len+1 floats per path
+    std::vector<PathBuffer> frontier_;
+    std::vector<float> frontier_probs_;
+    SpscQueue<float> raw_queue_, evt_queue_;
     u32 prev_size_,
         event_i_,
         chunk_i_;
     Timer chunk_timer_, map_timer_;
     float map_time_, wait_time_;
 
+    //Steady clock time in ns when the oldest unmapped signal was received,
+    //or 0 if all received signal has been mapped. Read by other threads
+    std::atomic<i64> pending_since_;
+    void update_pending();
+
+    //Samples received for the current read. Added to by add_chunk while
+    //the read is mapped, and only copied into read_ by the mapping thread
+    std::atomic<u64> raw_len_;
+
+    //Set by process_chunk, which may run on a signal thread. The mean
+    //event length is copied from evdt_ as events are queued, so the
+    //mapping thread never reads the detector
+    std::atomic<bool> chunk_processed_;
+    std::atomic<float> mean_evt_len_;
+
+    bool queue_normalized();
+
     std::mutex chunk_mtx_;
 
 
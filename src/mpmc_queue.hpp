@@ -0,0 +1,117 @@
+/* MIT License
+ *
+ * Copyright (c) 2018 Sam Kovaka <skovaka@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _INCL_MPMC_QUEUE
+#define _INCL_MPMC_QUEUE
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include "util.hpp"
+
+//Bounded blocking queue shared by any number of producer and consumer 
+//threads. push waits while the queue is full and pop waits while it is
+//empty, so neither side needs to poll. Once closed, push fails and pop
+//returns the remaining values, then fails
+template <typename T>
+class MpmcQueue {
+    public:
+
+    MpmcQueue(u32 capacity) : capacity_(capacity), closed_(false) {}
+
+    bool push(T &&v) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        not_full_.wait(lock, [this] {
+            return queue_.size() < capacity_ || closed_;
+        });
+        if (closed_) return false;
+
+        queue_.push_back(std::move(v));
+        lock.unlock();
+        not_empty_.notify_one();
+        return true;
+    }
+
+    bool pop(T &v) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        not_empty_.wait(lock, [this] {
+            return !queue_.empty() || closed_;
+        });
+        if (queue_.empty()) return false;
+
+        v = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+        not_full_.notify_one();
+        return true;
+    }
+
+    //Appends everything currently queued to out without waiting
+    u32 pop_all(std::vector<T> &out) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        u32 n = queue_.size();
+        for (T &v : queue_) out.push_back(std::move(v));
+        queue_.clear();
+        lock.unlock();
+        not_full_.notify_all();
+        return n;
+    }
+
+    //Wakes all waiting threads. Values already queued can still be popped
+    void close() {
+        mtx_.lock();
+        closed_ = true;
+        mtx_.unlock();
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+    void clear() {
+        mtx_.lock();
+        queue_.clear();
+        mtx_.unlock();
+        not_full_.notify_all();
+    }
+
+    bool empty() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return queue_.empty();
+    }
+
+    //True once closed and fully drained
+    bool finished() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return closed_ && queue_.empty();
+    }
+
+    private:
+    std::deque<T> queue_;
+    u32 capacity_;
+    bool closed_;
+
+    std::mutex mtx_;
+    std::condition_variable not_full_, not_empty_;
+};
+
+#endif
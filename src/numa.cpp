@@ -0,0 +1,108 @@
+/* MIT License
+ *
+ * Copyright (c) 2018 Sam Kovaka <skovaka@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#include "numa.hpp"
+
+std::vector< std::vector<u16> > Numa::node_cpus_;
+
+//Parses node cpulist files, e.g. "0-15,32-47"
+void Numa::load() {
+    if (!node_cpus_.empty()) return;
+
+    #ifdef __linux__
+    for (u16 node = 0; ; node++) {
+        std::ifstream cpulist("/sys/devices/system/node/node" + 
+                              std::to_string(node) + "/cpulist");
+        if (!cpulist.is_open()) break;
+
+        std::vector<u16> cpus;
+        std::string range;
+        while (std::getline(cpulist, range, ',')) {
+            u32 st, en;
+            char dash;
+            std::istringstream rs(range);
+            if (!(rs >> st)) continue;
+            if (!(rs >> dash >> en)) en = st;
+            for (u32 c = st; c <= en; c++) cpus.push_back(c);
+        }
+
+        node_cpus_.push_back(cpus);
+    }
+    #endif
+
+    if (node_cpus_.empty()) {
+        node_cpus_.emplace_back();
+    }
+}
+
+u16 Numa::node_count() {
+    load();
+    return node_cpus_.size();
+}
+
+const std::vector<u16> &Numa::node_cpus(u16 node) {
+    load();
+    return node_cpus_[node % node_cpus_.size()];
+}
+
+u16 Numa::current_node() {
+    load();
+
+    #ifdef __linux__
+    int cpu = sched_getcpu();
+    for (u16 node = 0; node < node_cpus_.size() && cpu >= 0; node++) {
+        for (u16 c : node_cpus_[node]) {
+            if (c == cpu) return node;
+        }
+    }
+    #endif
+
+    return 0;
+}
+
+u16 Numa::thread_node(u16 tid, u16 num_threads) {
+    if (num_threads == 0) return 0;
+    return (u32) tid * node_count() / num_threads;
+}
+
+bool Numa::pin_thread(u16 node) {
+    const std::vector<u16> &cpus = node_cpus(node);
+    if (cpus.empty()) return false;
+
+    #ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (u16 c : cpus) CPU_SET(c, &set);
+
+    if (sched_setaffinity(0, sizeof(set), &set) == 0) return true;
+    std::cerr << "Warning: failed to pin thread to NUMA node " << node << "\n";
+    #endif
+
+    return false;
+}
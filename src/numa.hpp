@@ -0,0 +1,53 @@
+/* MIT License
+ *
+ * Copyright (c) 2018 Sam Kovaka <skovaka@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _INCL_NUMA
+#define _INCL_NUMA
+
+#include <vector>
+#include "util.hpp"
+
+//Linux NUMA topology from /sys, used to keep mapping threads and the
+//index replicas they search on the same memory node. On other systems,
+//or if the topology can't be read, every CPU is treated as one node
+class Numa {
+    public:
+
+    static u16 node_count();
+    static const std::vector<u16> &node_cpus(u16 node);
+
+    //Node of the CPU the calling thread is running on
+    static u16 current_node();
+
+    //Node a thread should run on, splitting threads evenly between nodes
+    static u16 thread_node(u16 tid, u16 num_threads);
+
+    //Restricts the calling thread to the CPUs of a node
+    static bool pin_thread(u16 node);
+
+    private:
+    static void load();
+    static std::vector< std::vector<u16> > node_cpus_;
+};
+
+#endif
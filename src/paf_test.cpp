@@ -0,0 +1,88 @@
+#include <iostream>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "realtime_pool.hpp"
+
+//Counts heap allocations made while a read's Paf is filled in by the mapper,
+//returned from RealtimePool::update, tagged with a decision and formatted
+//
+//  paf_test [reads]
+//
+//Returns nonzero if any allocations were made for reads with IDs short
+//enough to be stored inline
+
+static std::atomic<u64> allocs(0);
+
+void *operator new(size_t n) {
+    allocs++;
+    void *p = malloc(n == 0 ? 1 : n);
+    if (p == NULL) throw std::bad_alloc();
+    return p;
+}
+
+//Not inlined, so GCC doesn't mistake free for a mismatched deallocation
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+//Returns the mean number of allocations per read
+float count_allocs(const std::string &id, u32 nreads) {
+    std::vector<std::string> ref_names = {"chr1", "NC_000913.3"};
+
+    //Buffers reused between update calls are allocated up front
+    std::vector<MapResult> results;
+    results.reserve(nreads);
+    std::vector<Paf> out;
+    out.reserve(nreads);
+    std::string line;
+    line.reserve(1024);
+
+    u64 a0 = allocs;
+
+    for (u32 i = 0; i < nreads; i++) {
+        //Mapper::new_read, map_chunk and set_ref_loc
+        Paf paf(id, 5, 1000);
+        paf.set_float(Paf::Tag::QUEUE_TIME, 1);
+        paf.set_float(Paf::Tag::MAP_TIME, 2);
+        paf.set_float(Paf::Tag::WAIT_TIME, 3);
+        paf.set_read_len(400);
+        paf.set_mapped(1, 300, ref_names, 1, 100, 400, 50000, true, 200);
+        paf.set_int(Paf::Tag::DEVICE, 0);
+
+        //RealtimePool::update_pool
+        results.emplace_back(5, i, paf);
+
+        //RealtimePool::update_batch
+        Paf &res = std::get<2>(results.back());
+        res.set_float(Paf::Tag::EJECT, 0.5);
+        res.set_int(Paf::Tag::DELAY, 3);
+        out.push_back(std::move(res));
+
+        //PafWriter
+        line.clear();
+        out.back().write_paf(line);
+    }
+
+    return (float) (allocs - a0) / nreads;
+}
+
+int main(int argc, char **argv) {
+    u32 nreads = argc > 1 ? atoi(argv[1]) : 1000;
+
+    std::string uuid = "a1b2c3d4-e5f6-7890-abcd-ef1234567890",
+                long_id = uuid + "_" + uuid;
+
+    float n_uuid = count_allocs(uuid, nreads),
+          n_long = count_allocs(long_id, nreads);
+
+    std::cout << "allocations per read\n"
+              << "uuid\t" << n_uuid << "\n"
+              << "long_id\t" << n_long << "\n";
+
+    return n_uuid > 0;
+}
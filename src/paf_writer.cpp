@@ -0,0 +1,390 @@
+/* MIT License
+ *
+ * Copyright (c) 2018 Sam Kovaka <skovaka@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <chrono>
+#include <fstream>
+#include <cstring>
+#include <climits>
+#include "paf_writer.hpp"
+
+constexpr float PafWriter::DEF_FLUSH_MS;
+
+const char PafWriter::BIN_MAGIC[8] = "UNCLPAF";
+
+//Must match BIN_DTYPE in uncalled/pafstats.py
+static_assert(sizeof(PafWriter::BinRecord) == 80, "Unexpected BinRecord size");
+static_assert(sizeof(PafWriter::BinFooter) == 32, "Unexpected BinFooter size");
+
+PafWriter::PafWriter(std::ostream &out, Format fmt, 
+                     u32 buffer_size, float flush_ms)
+    : out_(out),
+      fmt_(fmt),
+      buffer_size_(buffer_size),
+      flush_ms_(flush_ms),
+      running_(false),
+      flush_req_(0),
+      flush_done_(0),
+      bin_records_(0) {
+    buffer_.reserve(buffer_size_);
+}
+
+PafWriter::~PafWriter() {
+    close();
+}
+
+//Starts the writer thread if it isn't running. Called with mtx_ held
+void PafWriter::start() {
+    if (running_) return;
+    running_ = true;
+    flush_timer_.reset();
+    thread_ = std::thread(&PafWriter::run, this);
+}
+
+void PafWriter::write(Paf &&paf) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    start();
+    queue_.push_back({std::move(paf), std::string(), false});
+    if (queue_.size() == WAKE_COUNT) queue_cv_.notify_one();
+}
+
+void PafWriter::write(const Paf &paf) {
+    write(Paf(paf));
+}
+
+void PafWriter::write_comment(const std::string &comment) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    start();
+    queue_.push_back({Paf(), comment, true});
+    if (queue_.size() == WAKE_COUNT) queue_cv_.notify_one();
+}
+
+void PafWriter::flush() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (!running_) return;
+
+    u64 req = ++flush_req_;
+    queue_cv_.notify_one();
+    flushed_cv_.wait(lock, [this, req] {return flush_done_ >= req;});
+}
+
+//Must not be called concurrently with write
+void PafWriter::close() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!running_) return;
+        running_ = false;
+    }
+    queue_cv_.notify_one();
+    thread_.join();
+}
+
+void PafWriter::run() {
+    std::unique_lock<std::mutex> lock(mtx_);
+
+    bool stopping = false;
+    while (!stopping) {
+
+        //Sleep until the buffer is due to be flushed, unless there
+        //is enough work to do now
+        double wait = flush_ms_ - flush_timer_.get();
+        if (running_ && wait > 0 && 
+            flush_req_ == flush_done_ && queue_.size() < WAKE_COUNT) {
+            queue_cv_.wait_for(lock, 
+                std::chrono::microseconds((u64) (wait * 1000)));
+        }
+
+        stopping = !running_;
+        u64 req = flush_req_;
+        batch_.swap(queue_);
+
+        //Format without blocking writers
+        lock.unlock();
+
+        for (Record &r : batch_) {
+            if (!r.is_comment) {
+                format(r.paf);
+            } else if (fmt_ == Format::TEXT) {
+                buffer_.push_back('#');
+                buffer_.append(r.comment);
+                buffer_.push_back('\n');
+            }
+        }
+        batch_.clear();
+
+        if (stopping && fmt_ == Format::BINARY) {
+            write_bin_footer();
+        }
+
+        if (stopping || req != flush_done_ || 
+            buffer_.size() >= buffer_size_ || 
+            flush_timer_.get() >= flush_ms_) {
+            write_buffer();
+        }
+
+        lock.lock();
+
+        if (req != flush_done_) {
+            flush_done_ = req;
+            flushed_cv_.notify_all();
+        }
+    }
+}
+
+void PafWriter::write_buffer() {
+    if (!buffer_.empty()) {
+        out_.write(buffer_.data(), buffer_.size());
+        out_.flush();
+        buffer_.clear();
+    }
+    flush_timer_.reset();
+}
+
+void PafWriter::format(const Paf &paf) {
+    if (fmt_ == Format::TEXT) {
+        paf.write_paf(buffer_);
+    } else {
+        write_bin(paf);
+    }
+}
+
+void PafWriter::write_bin(const Paf &paf) {
+    if (bin_records_ == 0) {
+        BinHeader h;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, BIN_MAGIC, sizeof(h.magic));
+        h.version = BIN_VERSION;
+        h.record_size = sizeof(BinRecord);
+        buffer_.append((char *) &h, sizeof(h));
+    }
+
+    BinRecord r;
+    memset(&r, 0, sizeof(r));
+
+    std::string rd_name(paf.get_rd_name());
+    auto read = read_idxs_.find(rd_name);
+    if (read == read_idxs_.end()) {
+        read = read_idxs_.emplace(rd_name, read_idxs_.size()).first;
+        read_names_.append(rd_name);
+        read_names_.push_back('\0');
+    }
+    r.read = read->second;
+    r.rd_len = paf.rd_len_;
+
+    if (paf.is_mapped_) {
+        const std::string &rf_name = paf.get_rf_name();
+        auto ref = ref_idxs_.find(rf_name);
+        if (ref == ref_idxs_.end()) {
+            ref = ref_idxs_.emplace(rf_name, ref_idxs_.size()).first;
+            ref_names_.append(rf_name);
+            ref_names_.push_back('\0');
+            ref_lens_.push_back(paf.rf_len_);
+        }
+        r.ref = ref->second;
+        r.rd_st = paf.rd_st_;
+        r.rd_en = paf.rd_en_;
+        r.rf_st = paf.rf_st_;
+        r.rf_en = paf.rf_en_;
+        r.matches = paf.matches_;
+        r.flags = BIN_MAPPED | (paf.fwd_ ? BIN_FWD : 0);
+    } else {
+        r.ref = UINT_MAX;
+    }
+
+    r.ch = paf.get_int(Paf::Tag::CHANNEL);
+    r.st = paf.get_int(Paf::Tag::READ_START);
+    r.dl = paf.get_int(Paf::Tag::DELAY);
+    r.mt = paf.get_float(Paf::Tag::MAP_TIME);
+    r.wt = paf.get_float(Paf::Tag::WAIT_TIME);
+    r.qt = paf.get_float(Paf::Tag::QUEUE_TIME);
+    r.ej = paf.get_float(Paf::Tag::EJECT);
+    r.kp = paf.get_float(Paf::Tag::KEEP);
+    r.en = paf.get_float(Paf::Tag::ENDED);
+    r.mx = paf.get_float(Paf::Tag::IN_SCAN);
+    r.tags = (paf.int_mask_ & BIN_INT_TAGS) | (paf.float_mask_ & BIN_FLOAT_TAGS);
+
+    buffer_.append((char *) &r, sizeof(r));
+    bin_records_++;
+}
+
+//Appends name tables and the footer after the last record
+void PafWriter::write_bin_footer() {
+    if (bin_records_ == 0) return;
+
+    buffer_.append((char *) ref_lens_.data(), ref_lens_.size() * sizeof(u64));
+    buffer_.append(ref_names_);
+    buffer_.append(read_names_);
+
+    BinFooter f;
+    memset(&f, 0, sizeof(f));
+    f.record_count = bin_records_;
+    f.read_count = read_idxs_.size();
+    f.ref_count = ref_idxs_.size();
+    f.ref_names_len = ref_names_.size();
+    memcpy(f.magic, BIN_MAGIC, sizeof(f.magic));
+    buffer_.append((char *) &f, sizeof(f));
+
+    bin_records_ = 0;
+    read_idxs_.clear();
+    ref_idxs_.clear();
+    read_names_.clear();
+    ref_names_.clear();
+    ref_lens_.clear();
+}
+
+bool PafWriter::is_binary(const std::string &fname) {
+    std::ifstream in(fname, std::ios::binary);
+    char magic[sizeof(BIN_MAGIC)-1];
+    return in.read(magic, sizeof(magic)) && 
+           memcmp(magic, BIN_MAGIC, sizeof(magic)) == 0;
+}
+
+//Splits a block of NUL terminated names
+static bool split_names(const std::string &blob, u32 count,
+                        std::vector<std::string> &names) {
+    names.reserve(count);
+    size_t st = 0;
+    while (names.size() < count) {
+        size_t en = blob.find('\0', st);
+        if (en == std::string::npos) return false;
+        names.emplace_back(blob, st, en - st);
+        st = en + 1;
+    }
+    return true;
+}
+
+bool PafWriter::to_text(const std::string &fname, std::ostream &out) {
+    std::ifstream in(fname, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Error: failed to open \"" << fname << "\"\n";
+        return false;
+    }
+
+    BinHeader h;
+    BinFooter f;
+
+    in.seekg(0, std::ios::end);
+    u64 fsize = in.tellg();
+
+    in.seekg(0);
+    bool valid = fsize >= sizeof(h) + sizeof(f) &&
+                 in.read((char *) &h, sizeof(h)) &&
+                 memcmp(h.magic, BIN_MAGIC, sizeof(h.magic)) == 0;
+
+    if (valid) {
+        in.seekg(fsize - sizeof(f));
+        valid = in.read((char *) &f, sizeof(f)) &&
+                memcmp(f.magic, BIN_MAGIC, sizeof(f.magic)) == 0;
+    }
+
+    if (!valid) {
+        std::cerr << "Error: \"" << fname << "\" is not a complete binary PAF file\n";
+        return false;
+    }
+
+    if (h.version != BIN_VERSION || h.record_size != sizeof(BinRecord)) {
+        std::cerr << "Error: \"" << fname << "\" was written by an "
+                  << "incompatible version\n";
+        return false;
+    }
+
+    //Load name tables from the end of the file
+    u64 names_offs = sizeof(h) + f.record_count * sizeof(BinRecord),
+        lens_size = f.ref_count * sizeof(u64);
+
+    if (names_offs + lens_size + f.ref_names_len + sizeof(f) > fsize) {
+        std::cerr << "Error: \"" << fname << "\" is truncated\n";
+        return false;
+    }
+
+    std::vector<u64> ref_lens(f.ref_count);
+    std::string ref_blob(f.ref_names_len, '\0'),
+                read_blob(fsize - sizeof(f) - names_offs - lens_size - f.ref_names_len, '\0');
+
+    in.seekg(names_offs);
+    in.read((char *) ref_lens.data(), lens_size);
+    in.read(&ref_blob[0], ref_blob.size());
+    in.read(&read_blob[0], read_blob.size());
+
+    std::vector<std::string> ref_names, read_names;
+    if (!in || !split_names(ref_blob, f.ref_count, ref_names) ||
+               !split_names(read_blob, f.read_count, read_names)) {
+        std::cerr << "Error: failed to read names from \"" << fname << "\"\n";
+        return false;
+    }
+
+    in.seekg(sizeof(h));
+
+    std::vector<BinRecord> block(4096);
+    std::string text;
+    text.reserve(DEF_BUFFER_SIZE);
+
+    u64 remain = f.record_count;
+    while (remain > 0) {
+        u64 n = remain < block.size() ? remain : block.size();
+        if (!in.read((char *) block.data(), n * sizeof(BinRecord))) {
+            std::cerr << "Error: failed to read records from \"" << fname << "\"\n";
+            return false;
+        }
+        remain -= n;
+
+        for (u64 i = 0; i < n; i++) {
+            const BinRecord &r = block[i];
+            if (r.read >= read_names.size() || 
+                (r.flags & BIN_MAPPED && r.ref >= ref_names.size())) {
+                std::cerr << "Error: invalid record in \"" << fname << "\"\n";
+                return false;
+            }
+
+            Paf paf;
+            paf.set_rd_name(read_names[r.read]);
+            paf.rd_len_ = r.rd_len;
+
+            if (r.flags & BIN_MAPPED) {
+                paf.set_mapped(r.rd_st, r.rd_en, ref_names, r.ref,
+                               r.rf_st, r.rf_en, ref_lens[r.ref],
+                               r.flags & BIN_FWD, r.matches);
+            }
+
+            #define SET_BIN_TAG(T, F, V) \
+                if (r.tags & (1 << Paf::Tag::T)) paf.F(Paf::Tag::T, r.V);
+            SET_BIN_TAG(CHANNEL,    set_int,   ch)
+            SET_BIN_TAG(READ_START, set_int,   st)
+            SET_BIN_TAG(DELAY,      set_int,   dl)
+            SET_BIN_TAG(MAP_TIME,   set_float, mt)
+            SET_BIN_TAG(WAIT_TIME,  set_float, wt)
+            SET_BIN_TAG(QUEUE_TIME, set_float, qt)
+            SET_BIN_TAG(EJECT,      set_float, ej)
+            SET_BIN_TAG(KEEP,       set_float, kp)
+            SET_BIN_TAG(ENDED,      set_float, en)
+            SET_BIN_TAG(IN_SCAN,    set_float, mx)
+
+            paf.write_paf(text);
+        }
+
+        out.write(text.data(), text.size());
+        text.clear();
+    }
+
+    out.flush();
+    return true;
+}
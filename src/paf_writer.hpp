@@ -0,0 +1,202 @@
+/* MIT License
+ *
+ * Copyright (c) 2018 Sam Kovaka <skovaka@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _INCL_PAF_WRITER
+#define _INCL_PAF_WRITER
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "read_buffer.hpp"
+#include "util.hpp"
+
+#ifdef PYBIND
+#include <pybind11/pybind11.h>
+#endif
+
+//Writes PAF records from a background thread, so mapping loops don't
+//spend time formatting and flushing output. Records are queued as Paf
+//objects, then formatted in batches into a large buffer which is
+//written when it fills or when buffered records reach a maximum age.
+//Everything queued is written by flush, close, or the destructor
+//
+//In BINARY format each record is a fixed-width BinRecord, with read and
+//reference names stored once in tables at the end of the file:
+//  BinHeader, BinRecord[record_count], u64 ref_len[ref_count],
+//  ref names, read names (each NUL terminated), BinFooter
+//The file is only complete after close. Records can be loaded directly
+//with numpy, see uncalled/pafstats.py, or converted with to_text
+class PafWriter {
+    public:
+
+    enum class Format {TEXT, BINARY};
+
+    static const char BIN_MAGIC[8];
+    static const u8 BIN_VERSION = 1;
+
+    typedef struct {
+        char magic[7];
+        u8 version;
+        u32 record_size, pad_;
+    } BinHeader;
+
+    //Only a fixed set of tags are stored. Bit (1 << Paf::Tag) of tags
+    //is set if the tag is present
+    typedef struct {
+        i64 st;
+        u32 read, ref;
+        u32 rd_len, rd_st, rd_en, 
+            rf_st, rf_en;
+        i32 ch, dl;
+        float mt, wt, qt, ej, kp, en, mx;
+        u16 matches, tags;
+        u8 flags, pad_[3];
+    } BinRecord;
+
+    static const u8 BIN_MAPPED = 1, BIN_FWD = 2;
+
+    //Tags stored in BinRecords
+    static const u16 
+        BIN_INT_TAGS = (1 << Paf::Tag::CHANNEL) | 
+                       (1 << Paf::Tag::READ_START) | 
+                       (1 << Paf::Tag::DELAY),
+        BIN_FLOAT_TAGS = (1 << Paf::Tag::MAP_TIME) | 
+                         (1 << Paf::Tag::WAIT_TIME) | 
+                         (1 << Paf::Tag::QUEUE_TIME) | 
+                         (1 << Paf::Tag::EJECT) | 
+                         (1 << Paf::Tag::KEEP) | 
+                         (1 << Paf::Tag::ENDED) | 
+                         (1 << Paf::Tag::IN_SCAN);
+
+    typedef struct {
+        u64 record_count;
+        u32 read_count, ref_count;
+        u64 ref_names_len;
+        char magic[8];
+    } BinFooter;
+
+    //Writes a binary PAF file as text PAF. Returns false on error
+    static bool to_text(const std::string &fname, std::ostream &out);
+
+    static bool is_binary(const std::string &fname);
+
+    static const u32 DEF_BUFFER_SIZE = 1 << 20;
+    static constexpr float DEF_FLUSH_MS = 100;
+
+    //Queue length at which the writer thread is woken before the
+    //flush interval ends
+    static const u32 WAKE_COUNT = 256;
+
+    PafWriter(std::ostream &out = std::cout, 
+              Format fmt = Format::TEXT,
+              u32 buffer_size = DEF_BUFFER_SIZE, 
+              float flush_ms = DEF_FLUSH_MS);
+
+    PafWriter(const PafWriter &w) = delete;
+
+    ~PafWriter();
+
+    void write(Paf &&paf);
+    void write(const Paf &paf);
+
+    //Writes a line prefixed with "#" after the records already queued
+    //Ignored in BINARY format
+    void write_comment(const std::string &comment);
+
+    //Blocks until all queued records are written and flushed
+    void flush();
+
+    //Writes all queued records and stops the writer thread
+    //Records written after close are written by a new thread, but in
+    //BINARY format the file is finished by close
+    void close();
+
+    #ifdef PYBIND
+
+    #define PY_PAF_WRITER_METH(P) c.def(#P, &PafWriter::P);
+
+    static void pybind_defs(pybind11::class_<PafWriter> &c) {
+        c.def(pybind11::init());
+        c.def(pybind11::init([](bool binary) {
+            return new PafWriter(std::cout, 
+                binary ? Format::BINARY : Format::TEXT);
+        }));
+        c.def_static("to_text", [](const std::string &fname) {
+            return PafWriter::to_text(fname, std::cout);
+        });
+        c.def_static("is_binary", &PafWriter::is_binary);
+        c.def("write", 
+              static_cast<void (PafWriter::*)(const Paf &)>(&PafWriter::write));
+        PY_PAF_WRITER_METH(write_comment);
+        c.def("flush", &PafWriter::flush, 
+              pybind11::call_guard<pybind11::gil_scoped_release>());
+        c.def("close", &PafWriter::close,
+              pybind11::call_guard<pybind11::gil_scoped_release>());
+    }
+
+    #endif
+
+    private:
+
+    //A queued record, or a comment line if is_comment is set
+    typedef struct {
+        Paf paf;
+        std::string comment;
+        bool is_comment;
+    } Record;
+
+    void start();
+    void run();
+    void write_buffer();
+
+    void format(const Paf &paf);
+    void write_bin(const Paf &paf);
+    void write_bin_footer();
+
+    std::ostream &out_;
+    Format fmt_;
+    u32 buffer_size_;
+    float flush_ms_;
+
+    std::vector<Record> queue_, batch_;
+    std::string buffer_;
+
+    std::thread thread_;
+    std::mutex mtx_;
+    std::condition_variable queue_cv_, flushed_cv_;
+    bool running_;
+    u64 flush_req_, flush_done_;
+    Timer flush_timer_;
+
+    //Name tables for BINARY format
+    u64 bin_records_;
+    std::unordered_map<std::string, u32> read_idxs_, ref_idxs_;
+    std::string read_names_, ref_names_;
+    std::vector<u64> ref_lens_;
+};
+
+#endif
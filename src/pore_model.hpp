@@ -181,6 +181,10 @@ class PoreModel {
         return lv_means_[kmer];
     }
 
+    float get_stdv(u16 kmer) const {
+        return sqrt(lv_vars_x2_[kmer] / 2);
+    }
+
     bool is_loaded() const {
         return loaded_;
     }
@@ -194,6 +198,7 @@ class PoreModel {
         PY_PORE_MODEL_METH(get_means_mean);
         PY_PORE_MODEL_METH(get_means_stdv);
         PY_PORE_MODEL_METH(get_mean);
+        PY_PORE_MODEL_METH(get_stdv);
     }
 
     #endif
@@ -5,6 +5,7 @@
 #include "self_align_ref.hpp"
 #include "realtime_pool.hpp"
 #include "client_sim.hpp"
+#include "paf_writer.hpp"
 #include "model_r94.inl"
 
 namespace py = pybind11;
@@ -28,6 +29,9 @@ PYBIND11_MODULE(_uncalled, m) {
     py::class_<Paf> paf(m, "Paf");
     Paf::pybind_defs(paf);
 
+    py::class_<PafWriter> paf_writer(m, "PafWriter");
+    PafWriter::pybind_defs(paf_writer);
+
     py::class_<BwaIndex<KLEN>> bwa_index(m, "BwaIndex");
     BwaIndex<KLEN>::pybind_defs(bwa_index);
 
@@ -40,6 +44,12 @@ PYBIND11_MODULE(_uncalled, m) {
     py::class_<Fast5Reader> fast5_reader(m, "Fast5Reader");
     Fast5Reader::pybind_defs(fast5_reader);
 
+    py::class_<SignalCache> signal_cache(m, "SignalCache");
+    SignalCache::pybind_defs(signal_cache);
+
+    py::class_<SignalGen> signal_gen(m, "SignalGen");
+    SignalGen::pybind_defs(signal_gen);
+
     py::class_<Event> event(m, "Event");
     py::class_<EventDetector> event_detector(m, "EventDetector");
     EventDetector::pybind_defs(event_detector, event);
@@ -21,13 +21,18 @@
  * SOFTWARE.
  */
 
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include "read_buffer.hpp"
+#include "vbz.hpp"
 
 ReadBuffer::Params ReadBuffer::PRMS = {
     num_channels : 512,
     bp_per_sec   : 450,
     sample_rate  : 4000,
     chunk_time   : 1.0,
+    slice_time   : 0,
     max_chunks   : 1000000,
 };
 
@@ -46,14 +51,15 @@ const std::string Paf::PAF_TAGS[] = {
     "kp", //KEEP
     "dl", //DELAY
     "sc", //SEED_CLUSTER
-    "ce"  //CONFIDENT_EVENT
+    "ce", //CONFIDENT_EVENT
+    "dv"  //DEVICE
 };
 
 Paf::Paf() 
     : is_mapped_(false),
       ended_(false),
-      rd_name_(""),
-      rf_name_(""),
+      rf_names_(NULL),
+      rf_id_(0),
       rd_st_(0),
       rd_en_(0),
       rd_len_(0),
@@ -61,22 +67,16 @@ Paf::Paf()
       rf_en_(0),
       rf_len_(0),
       fwd_(false),
-      matches_(0) {}
+      matches_(0),
+      int_mask_(0),
+      float_mask_(0) {
+    rd_name_[0] = '\0';
+}
 
 Paf::Paf(const std::string &rd_name, u16 channel, u64 start_sample)
-    : is_mapped_(false),
-      ended_(false),
-      rd_name_(rd_name),
-      rf_name_(""),
-      rd_st_(0),
-      rd_en_(0),
-      rd_len_(0),
-      rf_st_(0),
-      rf_en_(0),
-      rf_len_(0),
-      fwd_(false),
-      matches_(0) {
+    : Paf() {
     
+    set_rd_name(rd_name);
     set_int(Tag::CHANNEL, channel);
     set_int(Tag::READ_START, start_sample);
 }
@@ -90,44 +90,110 @@ bool Paf::is_ended() const {
 }
 
 void Paf::print_paf() const {
-    std::cout << rd_name_ << "\t"
-       << rd_len_ << "\t";
+    std::string line;
+    write_paf(line);
+    std::cout << line;
+}
+
+//Text conversion used by write_paf, which is faster than iostream
+//formatting and produces the same output
+static void append_uint(std::string &out, u64 v) {
+    char buf[20];
+    u8 i = sizeof(buf);
+    do {
+        buf[--i] = '0' + (v % 10);
+        v /= 10;
+    } while (v > 0);
+    out.append(buf + i, sizeof(buf) - i);
+}
+
+static void append_int(std::string &out, i64 v) {
+    if (v < 0) {
+        out.push_back('-');
+        append_uint(out, -(u64) v);
+    } else {
+        append_uint(out, (u64) v);
+    }
+}
+
+//Equivalent to std::fixed with the default precision of 6
+static void append_fixed(std::string &out, float v) {
+    double d = v;
+    if (!(d > -1e12 && d < 1e12)) {
+        char buf[64];
+        int n = snprintf(buf, sizeof(buf), "%f", d);
+        out.append(buf, n);
+        return;
+    }
+
+    if (std::signbit(d)) {
+        out.push_back('-');
+        d = -d;
+    }
+
+    //Exact for floats, and rounds ties to even like printf
+    u64 micros = (u64) std::nearbyint(d * 1000000.0);
+    append_uint(out, micros / 1000000);
+    out.push_back('.');
+
+    u32 frac = micros % 1000000;
+    char buf[6];
+    for (i8 i = 5; i >= 0; i--) {
+        buf[i] = '0' + (frac % 10);
+        frac /= 10;
+    }
+    out.append(buf, 6);
+}
+
+void Paf::write_paf(std::string &out) const {
+    out.append(get_rd_name());
+    out.push_back('\t');
+    append_uint(out, rd_len_);
+
     if (is_mapped_) {
-       std::cout 
-           << rd_st_ << "\t"
-           << rd_en_ << "\t"
-           << (fwd_ ? '+' : '-') << "\t"
-           << rf_name_ << "\t"
-           << rf_len_ << "\t"
-           << rf_st_ << "\t"
-           << rf_en_ << "\t"
-           << matches_ << "\t"
-           << (rf_en_ - rf_st_ + 1) << "\t"
-           << 255;
+        out.push_back('\t');
+        append_uint(out, rd_st_);
+        out.push_back('\t');
+        append_uint(out, rd_en_);
+        out.append(fwd_ ? "\t+\t" : "\t-\t");
+        out.append(get_rf_name());
+        out.push_back('\t');
+        append_uint(out, rf_len_);
+        out.push_back('\t');
+        append_uint(out, rf_st_);
+        out.push_back('\t');
+        append_uint(out, rf_en_);
+        out.push_back('\t');
+        append_uint(out, matches_);
+        out.push_back('\t');
+        append_uint(out, rf_en_ - rf_st_ + 1);
+        out.append("\t255");
     } else {
-        std::cout << "*" << "\t"
-           << "*" << "\t"
-           << "*" << "\t"
-           << "*" << "\t"
-           << "*" << "\t"
-           << "*" << "\t"
-           << "*" << "\t"
-           << "*" << "\t"
-           << "*" << "\t"
-           << "255";
+        out.append("\t*\t*\t*\t*\t*\t*\t*\t*\t*\t255");
     }
 
-    for (auto t : int_tags_) { 
-        std::cout << std::fixed << "\t" << PAF_TAGS[t.first] << ":i:" << t.second;
+    for (u8 t = 0; int_mask_ >> t; t++) { 
+        if (!has_int((Tag) t)) continue;
+        out.push_back('\t');
+        out.append(PAF_TAGS[t]);
+        out.append(":i:");
+        append_int(out, tag_vals_[t].i);
     }
-    for (auto t : float_tags_) { 
-        std::cout << std::fixed << "\t" << PAF_TAGS[t.first] << ":f:" << t.second;
+    for (u8 t = 0; float_mask_ >> t; t++) { 
+        if (!has_float((Tag) t)) continue;
+        out.push_back('\t');
+        out.append(PAF_TAGS[t]);
+        out.append(":f:");
+        append_fixed(out, tag_vals_[t].f);
     }
-    for (auto t : str_tags_) { 
-        std::cout << "\t" << PAF_TAGS[t.first] << ":Z:" << t.second;
+    for (auto &t : str_tags_) { 
+        out.push_back('\t');
+        out.append(PAF_TAGS[t.first]);
+        out.append(":Z:");
+        out.append(t.second);
     }
 
-    std::cout << "\n";
+    out.push_back('\n');
 }
 
 void Paf::set_read_len(u64 rd_len) {
@@ -140,13 +206,14 @@ void Paf::set_ended() {
 }
 
 void Paf::set_mapped(u64 rd_st, u64 rd_en,
-                          std::string rf_name,
-                          u64 rf_st, u64 rf_en, u64 rf_len,
-                          bool fwd, u16 matches) {
+                     const std::vector<std::string> &rf_names, u32 rf_id,
+                     u64 rf_st, u64 rf_en, u64 rf_len,
+                     bool fwd, u16 matches) {
     is_mapped_ = true;
     rd_st_ = rd_st;
     rd_en_ = rd_en;
-    rf_name_ = rf_name;
+    rf_names_ = &rf_names;
+    rf_id_ = rf_id;
     rf_st_ = rf_st;
     rf_en_ = rf_en;
     rf_len_ = rf_len;
@@ -155,34 +222,76 @@ void Paf::set_mapped(u64 rd_st, u64 rd_en,
 }
 
 void Paf::set_int(Tag t, int v) {
-    int_tags_.emplace_back(t, v);
+    tag_vals_[t].i = v;
+    int_mask_ |= 1 << t;
+    float_mask_ &= ~(1 << t);
 }
 
 void Paf::set_float(Tag t, float v) {
-    float_tags_.emplace_back(t, v);
+    tag_vals_[t].f = v;
+    float_mask_ |= 1 << t;
+    int_mask_ &= ~(1 << t);
 }
 
 void Paf::set_str(Tag t, std::string v) {
     str_tags_.emplace_back(t, v);
 }
 
+bool Paf::has_int(Tag t) const {
+    return (int_mask_ >> t) & 1;
+}
 
-ReadBuffer::ReadBuffer() {
-    chunk_count_ = 0;
-    
+bool Paf::has_float(Tag t) const {
+    return (float_mask_ >> t) & 1;
+}
+
+int Paf::get_int(Tag t) const {
+    return has_int(t) ? tag_vals_[t].i : 0;
+}
+
+float Paf::get_float(Tag t) const {
+    return has_float(t) ? tag_vals_[t].f : 0;
+}
+
+void Paf::set_rd_name(const std::string &rd_name) {
+    if (rd_name.size() <= RD_NAME_LEN) {
+        memcpy(rd_name_, rd_name.c_str(), rd_name.size()+1);
+        rd_name_long_.clear();
+    } else {
+        rd_name_[0] = '\0';
+        rd_name_long_ = rd_name;
+    }
+}
+
+const char *Paf::get_rd_name() const {
+    return rd_name_long_.empty() ? rd_name_ : rd_name_long_.c_str();
 }
 
+const std::string &Paf::get_rf_name() const {
+    static const std::string EMPTY;
+    return rf_names_ == NULL ? EMPTY : (*rf_names_)[rf_id_];
+}
+
+
+ReadBuffer::ReadBuffer() 
+    : device_(0),
+      raw_len_(0),
+      chunk_processed_(true) {}
+
 //TODO: eliminate swap from mapper, rely on automatic move constructor
 void ReadBuffer::swap(ReadBuffer &r) {
     //std::swap(source_, r.source_);
+    std::swap(device_, r.device_);
     std::swap(channel_idx_, r.channel_idx_);
     std::swap(id_, r.id_);
     std::swap(number_, r.number_);
     std::swap(start_sample_, r.start_sample_);
     std::swap(raw_len_, r.raw_len_);
+    std::swap(cal_digit_, r.cal_digit_);
+    std::swap(cal_range_, r.cal_range_);
+    std::swap(cal_offset_, r.cal_offset_);
     std::swap(full_signal_, r.full_signal_);
     std::swap(chunk_, r.chunk_);
-    std::swap(chunk_count_, r.chunk_count_);
     std::swap(chunk_processed_, r.chunk_processed_);
     std::swap(loc_, r.loc_);
 }
@@ -191,13 +300,13 @@ void ReadBuffer::clear() {
     raw_len_ = 0;
     full_signal_.clear();
     chunk_.clear();
-    chunk_count_ = 0;
     loc_ = Paf();
 }
 
 ReadBuffer::ReadBuffer(const hdf5_tools::File &file, 
                        const std::string &raw_path, 
-                       const std::string &ch_path) {
+                       const std::string &ch_path) 
+    : device_(0) {
 
     for (auto a : file.get_attr_map(raw_path)) {
         if (a.first == "read_id") {
@@ -224,13 +333,37 @@ ReadBuffer::ReadBuffer(const hdf5_tools::File &file,
 
     std::string sig_path = raw_path + "/Signal";
     std::vector<i16> int_data; 
-    file.read(sig_path, int_data);
 
-    chunk_count_ = (int_data.size() / PRMS.chunk_len()) + (int_data.size() % PRMS.chunk_len() != 0);
+    //Falls back to the HDF5 filter if VBZ can't be decoded natively
+    if (!Vbz::read_signal(file.id(), sig_path, int_data)) {
+        file.read(sig_path, int_data);
+    }
+
+    set_signal(int_data, cal_digit, cal_range, cal_offset);
+}
+
+ReadBuffer::ReadBuffer(const std::string &id, u16 channel, u32 number, 
+                       u64 start_sample, std::vector<i16> &int_data, 
+                       float cal_digit, float cal_range, float cal_offset)
+    : device_(0),
+      channel_idx_(channel-1),
+      id_(id),
+      number_(number),
+      start_sample_(start_sample) {
+    set_signal(int_data, cal_digit, cal_range, cal_offset);
+}
+
+//Calibrates raw fast5/slow5 signal, truncated to max_chunks
+void ReadBuffer::set_signal(std::vector<i16> &int_data, float cal_digit, 
+                            float cal_range, float cal_offset) {
+    cal_digit_ = cal_digit;
+    cal_range_ = cal_range;
+    cal_offset_ = cal_offset;
 
-    if (chunk_count_ > PRMS.max_chunks) {
-        chunk_count_ = PRMS.max_chunks;
-        int_data.resize(chunk_count_ * PRMS.chunk_len());
+    u32 chunk_count = (int_data.size() / PRMS.chunk_len()) + (int_data.size() % PRMS.chunk_len() != 0);
+
+    if (chunk_count > PRMS.max_chunks) {
+        int_data.resize(PRMS.max_chunks * PRMS.chunk_len());
     }
 
     //full_signal_.reserve(int_data.size());
@@ -248,11 +381,11 @@ ReadBuffer::ReadBuffer(const hdf5_tools::File &file,
 
 ReadBuffer::ReadBuffer(Chunk &first_chunk) 
     : //source_(Source::LIVE),
+      device_(first_chunk.get_device()),
       channel_idx_(first_chunk.get_channel_idx()),
       id_(first_chunk.get_id()),
       number_(first_chunk.get_number()),
       start_sample_(first_chunk.get_start()),
-      chunk_count_(1),
       chunk_processed_(false),
       loc_(id_, channel_idx_+1, start_sample_) {
     //loc_.set_int(Paf::Tag::RECEIVE_TIME, PARAMS.get_time());//TODO: FIX
@@ -265,20 +398,6 @@ void ReadBuffer::set_raw_len(u64 raw_len) {
     loc_.set_read_len(raw_len_ * PRMS.bp_per_samp());
 }
 
-bool ReadBuffer::add_chunk(Chunk &c) {
-    if (!chunk_processed_ || 
-        channel_idx_ != c.get_channel_idx() || 
-        number_ != c.get_number()) return false;
-
-    chunk_processed_ = false;
-
-    chunk_count_++;
-    set_raw_len(raw_len_+c.size());
-    c.pop(chunk_);
-
-    return true;
-}
-
 bool ReadBuffer::empty() const {
     return full_signal_.empty() && chunk_.empty();
 }
@@ -292,11 +411,12 @@ u16 ReadBuffer::get_channel_idx() const {
 }
 
 bool ReadBuffer::chunks_maxed() const {
-    return chunk_count_ >= PRMS.max_chunks;
+    return chunk_count() >= PRMS.max_chunks;
 }
 
+//Completed chunks, counted in samples so partial chunks add up to full ones
 u32 ReadBuffer::chunk_count() const {
-    return chunk_count_; //full_signal_.size() / PRMS.chunk_len();
+    return raw_len_ / PRMS.chunk_len();
 }
 
 Chunk ReadBuffer::get_chunk(u32 i) const {
@@ -318,11 +438,12 @@ Chunk ReadBuffer::get_chunk(u32 i) const {
 
 u32 ReadBuffer::get_chunks(std::vector<Chunk> &chunk_queue, bool real_start, u32 offs) const {
     u32 count = 0;
-    u16 l = PRMS.chunk_len();
+    u16 l = PRMS.slice_len();
+    u64 max_len = (u64) PRMS.max_chunks * PRMS.chunk_len();
 
     float start = real_start ? start_sample_ : 0;
 
-    for (u32 i = offs; i+l <= full_signal_.size() && count < PRMS.max_chunks; i += l) {
+    for (u32 i = offs; i+l <= full_signal_.size() && i-offs < max_len; i += l) {
         chunk_queue.emplace_back(id_, get_channel(), number_, 
                                  start+i, full_signal_, i, l);
         count++;
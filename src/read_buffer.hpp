@@ -53,18 +53,29 @@ class Paf {
         KEEP,
         DELAY,
         SEED_CLUSTER,
-        CONFIDENT_EVENT
+        CONFIDENT_EVENT,
+        DEVICE,
+        NUM_TAGS
     };
 
+    //Read IDs up to this length are stored without allocating
+    static const u8 RD_NAME_LEN = 47;
+
     Paf();
     Paf(const std::string &rd_name, u16 channel = 0, u64 start_sample = 0);
 
     bool is_mapped() const;
     bool is_ended() const;
     void print_paf() const;
+
+    //Appends the PAF line, including the newline, to out
+    void write_paf(std::string &out) const;
     void set_read_len(u64 rd_len);
+
+    //The reference name is stored as an index into rf_names,
+    //which must outlive the Paf
     void set_mapped(u64 rd_st, u64 rd_en, 
-                    std::string rf_name,
+                    const std::vector<std::string> &rf_names, u32 rf_id,
                     u64 rf_st, u64 rf_en, u64 rf_len,
                     bool fwd, u16 matches);
     void set_ended();
@@ -74,9 +85,13 @@ class Paf {
     void set_float(Tag t, float v);
     void set_str(Tag t, std::string v);
 
-    std::string get_rd_name() {
-        return rd_name_;
-    }
+    bool has_int(Tag t) const;
+    bool has_float(Tag t) const;
+    int get_int(Tag t) const;
+    float get_float(Tag t) const;
+
+    const char *get_rd_name() const;
+    const std::string &get_rf_name() const;
 
     #ifdef PYBIND
     #define PY_PAF_METH(P) c.def(#P, &Paf::P);
@@ -98,23 +113,43 @@ class Paf {
         PY_PAF_TAG(ENDED);
         PY_PAF_TAG(KEEP);
         PY_PAF_TAG(DELAY);
+        PY_PAF_TAG(DEVICE);
         t.export_values();
     }
 
     #endif
 
     private:
+    friend class PafWriter;
+
     static const std::string PAF_TAGS[];
 
+    static_assert(NUM_TAGS <= 16, "Tag masks are 16 bits");
+
+    void set_rd_name(const std::string &rd_name);
+
     bool is_mapped_, ended_;
-    std::string rd_name_, rf_name_;
+
+    //Longer read IDs are stored in rd_name_long_
+    char rd_name_[RD_NAME_LEN+1];
+    std::string rd_name_long_;
+
+    const std::vector<std::string> *rf_names_;
+    u32 rf_id_;
+
     u64 rd_st_, rd_en_, rd_len_,
         rf_st_, rf_en_, rf_len_;
     bool fwd_;
     u16 matches_;
 
-    std::vector< std::pair<Tag, int> > int_tags_;
-    std::vector< std::pair<Tag, float> > float_tags_;
+    //Bit (1 << Tag) of a mask is set if the tag has a value of that type
+    //Each tag has one value, so setting it again replaces it
+    u16 int_mask_, float_mask_;
+    union {
+        i32 i;
+        float f;
+    } tag_vals_[NUM_TAGS];
+
     std::vector< std::pair<Tag, std::string> > str_tags_;
 };
 
@@ -126,6 +161,7 @@ class ReadBuffer {
         float bp_per_sec;
         float sample_rate;
         float chunk_time;
+        float slice_time;
         u32 max_chunks;
 
         float bp_per_samp() {
@@ -135,6 +171,13 @@ class ReadBuffer {
         u16 chunk_len() {
             return (u16) (chunk_time * sample_rate);
         }
+
+        //Signal can be streamed in slices shorter than a chunk
+        //max_chunks still counts full chunks
+        u16 slice_len() {
+            if (slice_time <= 0) return chunk_len();
+            return (u16) (slice_time * sample_rate);
+        }
     } Params;
 
     static Params PRMS;
@@ -143,6 +186,9 @@ class ReadBuffer {
     ReadBuffer();
     ReadBuffer(const std::string &filename);
     ReadBuffer(const hdf5_tools::File &file, const std::string &raw_path, const std::string &ch_path);
+    ReadBuffer(const std::string &id, u16 channel, u32 number, 
+               u64 start_sample, std::vector<i16> &int_data, 
+               float cal_digit, float cal_range, float cal_offset);
     
     ReadBuffer(Chunk &first_chunk);
 
@@ -153,9 +199,9 @@ class ReadBuffer {
     u64 get_duration() const;
     u32 size() const {return full_signal_.size();}
     u16 get_channel() const;
+    u16 get_device() const {return device_;}
     const std::vector<float> &get_raw() const {return full_signal_;}
 
-    bool add_chunk(Chunk &c);
     Chunk &&pop_chunk();
     void swap(ReadBuffer &r);
     void clear();
@@ -187,6 +233,7 @@ class ReadBuffer {
         PY_READ_RPROP(end);
         PY_READ_RPROP(duration);
         PY_READ_RPROP(channel);
+        PY_READ_RPROP(device);
         PY_READ_RPROP(raw);
 
         pybind11::class_<Params> p(c, "Params");
@@ -194,18 +241,22 @@ class ReadBuffer {
         PY_READ_PRM(bp_per_sec);
         PY_READ_PRM(sample_rate);
         PY_READ_PRM(chunk_time);
+        PY_READ_PRM(slice_time);
         PY_READ_PRM(max_chunks);
     }
 
     #endif
 
+    void set_signal(std::vector<i16> &int_data, float cal_digit, 
+                    float cal_range, float cal_offset);
+
     //Source source_;
-    u16 channel_idx_;
+    u16 device_, channel_idx_;
     std::string id_;
     u32 number_;
     u64 start_sample_, raw_len_;
+    float cal_digit_, cal_range_, cal_offset_;
     std::vector<float> full_signal_, chunk_;
-    u16 chunk_count_;
     bool chunk_processed_;
 
     Paf loc_;
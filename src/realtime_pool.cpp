@@ -22,7 +22,7 @@
  */
 
 #include <thread>
-#include <chrono>
+#include <algorithm>
 #include <stdlib.h>
 #include <time.h>
 #include "realtime_pool.hpp"
@@ -39,40 +39,99 @@
 
 RealtimePool::RealtimePool(Conf &conf) :
     PRMS(conf.realtime_prms),
-    stopped_(false) {
+    stopped_(false),
+    idle_threads_(0),
+    paf_out_(std::cout, conf.get_paf_format()) {
 
+    if (PRMS.num_devices == 0) PRMS.num_devices = 1;
+    u32 pool_size = (u32) PRMS.num_devices * conf.get_num_channels();
+
+    mappers_.resize(pool_size);
+
+    threads_.reserve(conf.threads);
     for (u16 t = 0; t < conf.threads; t++) {
-        threads_.emplace_back(mappers_);
+        threads_.emplace_back(mappers_, results_, mapped_, idle_threads_, PRMS);
+    }
+
+    if (conf.numa) {
+        Mapper::load_replicas();
+        for (u16 t = 0; t < conf.threads; t++) {
+            threads_[t].numa_ = true;
+            threads_[t].numa_node_ = Numa::thread_node(t, conf.threads);
+        }
     }
 
-    mappers_.resize(conf.get_num_channels());
-    chunk_buffer_.resize(conf.get_num_channels());
-    buffer_queue_.reserve(conf.get_num_channels());
-    active_queue_.reserve(conf.get_num_channels());
+    chunk_buffer_.resize(pool_size);
+    chunk_times_.resize(pool_size, 0);
+    buffer_queue_.reserve(pool_size);
+    active_queue_.reserve(pool_size);
+
+    if (PRMS.signal_threads > 0) {
+        for (Mapper &m : mappers_) {
+            m.use_event_queue();
+        }
+
+        for (MapperThread &t : threads_) {
+            t.process_chunks_ = false;
+        }
 
+        signal_threads_.reserve(PRMS.signal_threads);
+        for (u16 t = 0; t < PRMS.signal_threads; t++) {
+            signal_threads_.emplace_back(mappers_, t, PRMS.signal_threads);
+        }
+    }
 
     for (u16 t = 0; t < conf.threads; t++) {
         threads_[t].start();
     }
 
+    for (SignalThread &t : signal_threads_) {
+        t.start();
+    }
+
     srand(time(NULL));
 }
 
+//Each device's channels are stored contiguously
+u32 RealtimePool::get_pool_idx(const Chunk &c) const {
+    return (u32) c.get_device() * ReadBuffer::PRMS.num_channels + 
+           c.get_channel_idx();
+}
+
+RealtimeParams::Mode RealtimePool::get_device_mode(u16 device) const {
+    if (device < PRMS.device_modes.size()) return PRMS.device_modes[device];
+    return PRMS.realtime_mode;
+}
+
 void RealtimePool::buffer_chunk(Chunk &c) {
-    u16 ch = c.get_channel_idx();
-    if (chunk_buffer_[ch].empty()) {
+    u32 ch = get_pool_idx(c);
+    Chunk &buf = chunk_buffer_[ch];
+    if (buf.empty()) {
         buffer_queue_.push_back(ch);
+
+    //Collect slices from the same read up to a full chunk
+    } else if (buf.get_number() == c.get_number() &&
+               buf.size() + c.size() <= ReadBuffer::PRMS.chunk_len()) {
+        buf.append(c);
+        return;
+
     } else {
         //TODO: handle backlog (probably reset paths?)
-        chunk_buffer_[ch].clear();
+        buf.clear();
     }
-    chunk_buffer_[ch].swap(c);
+    buf.swap(c);
 }
 
 
 //Add chunk to master buffer
 bool RealtimePool::add_chunk(Chunk &c) {
-    u16 ch = c.get_channel_idx();
+    if (c.get_device() >= PRMS.num_devices) {
+        std::cerr << "Error: chunk from device " << c.get_device() 
+                  << ", but pool only has " << PRMS.num_devices << "\n";
+        return false;
+    }
+
+    u32 ch = get_pool_idx(c);
 
     //Check if previous read is still aligning
     //If so, tell thread to reset, store chunk in pool buffer
@@ -93,24 +152,45 @@ bool RealtimePool::add_chunk(Chunk &c) {
     } else if (mappers_[ch].get_state() == Mapper::State::INACTIVE) {
         mappers_[ch].new_read(c);
         active_queue_.push_back(ch);
+        notify_signal(ch);
         return true;
 
     }
     
-    return mappers_[ch].add_chunk(c);
-    
+    //Hold any signal the mapper doesn't have room for until update,
+    //behind signal that's already waiting
+    u32 len = c.size();
+    bool added = chunk_buffer_[ch].empty() && mappers_[ch].add_chunk(c);
 
-    return false;
+    if (c.size() < len) notify_signal(ch);
+    if (!added) buffer_chunk(c);
+
+    return true;
+}
+
+void RealtimePool::notify_signal(u32 ch) {
+    if (!signal_threads_.empty()) {
+        signal_threads_[ch % signal_threads_.size()].chunks_.notify();
+    }
+}
+
+u32 RealtimePool::add_chunks(std::vector<Chunk> &chunks) {
+    u32 count = 0;
+    for (Chunk &c : chunks) {
+        count += add_chunk(c);
+    }
+    return count;
 }
 
 bool RealtimePool::is_read_finished(const ReadBuffer &r) {
-    u16 ch = r.get_channel_idx();
+    u32 ch = (u32) r.get_device() * ReadBuffer::PRMS.num_channels + 
+             r.get_channel_idx();
     return (mappers_[ch].finished() && 
             mappers_[ch].get_read().get_number() == r.get_number());
 }
 
 bool RealtimePool::try_add_chunk(Chunk &c) {
-    u16 ch = c.get_channel_idx();
+    u32 ch = get_pool_idx(c);
 
     //Chunk is empty if all read chunks were output
     if (c.empty()) {
@@ -126,6 +206,7 @@ bool RealtimePool::try_add_chunk(Chunk &c) {
     if (mappers_[ch].get_state() == Mapper::State::INACTIVE) {
         mappers_[ch].new_read(c);
         active_queue_.push_back(ch);
+        notify_signal(ch);
         return true;
 
     } else if (mappers_[ch].get_read().number_ == c.get_number()) {
@@ -135,37 +216,52 @@ bool RealtimePool::try_add_chunk(Chunk &c) {
             return false;
         }
 
-        return mappers_[ch].add_chunk(c);
+        u32 len = c.size();
+        bool added = mappers_[ch].add_chunk(c);
+        if (c.size() < len) notify_signal(ch);
+        return added;
     }
 
     return false;
 }
 
-//TODO: make sure update is the same
 std::vector<MapResult> RealtimePool::update() {
+    std::vector<u32> pool_idxs;
+    return update_pool(pool_idxs);
+}
+
+//Also outputs the pool index of each result, which identifies the device
+//TODO: make sure update is the same
+std::vector<MapResult> RealtimePool::update_pool(std::vector<u32> &pool_idxs) {
 
-    std::vector< u16 > read_counts(threads_.size(), 0);
+    std::vector< u32 > read_counts(threads_.size(), 0);
     active_count_ = 0;
     std::vector<MapResult> ret;
 
     //Get alignment outputs
     for (u16 t = 0; t < threads_.size(); t++) {
-        if (!threads_[t].out_chs_.empty()) {
+        //Loop over alignments
+        u32 ch;
+        while (threads_[t].out_chs_.pop(ch)) {
+            ReadBuffer &r = mappers_[ch].get_read();
+            if (PRMS.num_devices > 1) {
+                r.loc_.set_int(Paf::Tag::DEVICE, r.get_device());
+            }
+            ret.emplace_back(r.get_channel(), r.number_, r.loc_);
+            pool_idxs.push_back(ch);
 
-            //Store and empty thread output buffer
-            threads_[t].out_mtx_.lock();
-            out_chs_.swap(threads_[t].out_chs_);
-            threads_[t].out_mtx_.unlock();
+            //Signal buffered for a finished read would be mapped again
+            //as a new read once the mapper is inactive
+            Chunk &buf = chunk_buffer_[ch];
+            if (!buf.empty() && buf.get_number() == r.number_) buf.clear();
 
-            //Loop over alignments
-            for (auto ch : out_chs_) {
-                ReadBuffer &r = mappers_[ch].get_read();
-                ret.emplace_back(r.get_channel(), r.number_, r.loc_);
+            //TODO rename set_inactive?
+            mappers_[ch].deactivate();
+        }
 
-                //TODO rename set_inactive?
-                mappers_[ch].deactivate();
-            }
-            out_chs_.clear();
+        //Reassign channels given up by busy threads first
+        while (threads_[t].yield_chs_.pop(ch)) {
+            active_queue_.push_back(ch);
         }
 
         //Count reads aligning in each thread
@@ -174,18 +270,23 @@ std::vector<MapResult> RealtimePool::update() {
     }
 
     //Buffer queue should be ordered in "ord" mode
-    for (u16 i = buffer_queue_.size()-1; i < buffer_queue_.size(); i--) {
-        u16 ch = buffer_queue_[i];//TODO: store chunks in queue
+    for (u32 i = buffer_queue_.size()-1; i < buffer_queue_.size(); i--) {
+        u32 ch = buffer_queue_[i];//TODO: store chunks in queue
         Chunk &c = chunk_buffer_[ch];
 
         bool added = false;
 
-        if (mappers_[ch].get_state() == Mapper::State::INACTIVE) {
+        if (c.empty()) {
+            added = true;
+        } else if (mappers_[ch].get_state() == Mapper::State::INACTIVE) {
             mappers_[ch].new_read(c);
             active_queue_.push_back(ch);
+            notify_signal(ch);
             added = true;
         } else if (!mappers_[ch].finished()) {
+            u32 len = c.size();
             added = mappers_[ch].add_chunk(c);
+            if (c.size() < len) notify_signal(ch);
         }
 
         if (added) {
@@ -201,16 +302,16 @@ std::vector<MapResult> RealtimePool::update() {
     if (time_.get() >= 500 && active_count_ > 0) {
         std::cout << "#prefill_threads " 
                   << active_count_;
-        for (u16 c : read_counts) std::cout << " " << c;
+        for (u32 c : read_counts) std::cout << " " << c;
         std::cout << "\n";
         std::cout.flush();
     }
     #endif
 
     //Estimate how much to fill each thread
-    u16 target = min(active_queue_.size() + active_count_, PRMS.max_active_reads);
+    u32 target = min(active_queue_.size() + active_count_, PRMS.max_active_reads);
 
-    u16 min_per_thread = target / threads_.size(), // + (target % threads_.size() > 0);
+    u32 min_per_thread = target / threads_.size(), // + (target % threads_.size() > 0);
         remain = target % threads_.size();
 
     for (u32 c : read_counts) remain -= (c > min_per_thread);
@@ -222,21 +323,23 @@ std::vector<MapResult> RealtimePool::update() {
 
         u16 t = (st+i) % threads_.size();
 
-        u32 n = min_per_thread + (remain > 0) - read_counts[t];
+        u32 want = min_per_thread + (remain > 0);
 
-        //If thread not full
-        if (n > 0 && n <= active_queue_.size()) {
-            u32 r0 = active_queue_.size() - n,
-                rn = active_queue_.size();
+        //If thread not full, fill as much as possible
+        if (read_counts[t] < want) {
+            u32 n = want - read_counts[t];
+            if (n > active_queue_.size()) n = active_queue_.size();
 
-            threads_[t].in_mtx_.lock();
+            u32 r0 = active_queue_.size() - n;
 
-            std::vector<u16> &in_chs = threads_[t].in_chs_;
-            in_chs.insert(in_chs.end(),
-                          &(active_queue_[r0]),
-                          &(active_queue_[rn]));
+            for (u32 r = r0; r < active_queue_.size(); r++) {
+                threads_[t].in_chs_.push(active_queue_[r]);
+            }
 
+            //Lock only orders the push before an idle thread's wait
+            threads_[t].in_mtx_.lock();
             threads_[t].in_mtx_.unlock();
+            threads_[t].in_cv_.notify_one();
 
             active_queue_.resize(r0);
             remain -= (remain > 0);
@@ -251,7 +354,7 @@ std::vector<MapResult> RealtimePool::update() {
         time_.reset();
         std::cout << "#pstfill_threads "
                   << active_count_;
-        for (u16 c : read_counts) std::cout << " " << c;
+        for (u32 c : read_counts) std::cout << " " << c;
         std::cout << "\n";
         std::cout.flush();
     }
@@ -264,16 +367,125 @@ u32 RealtimePool::active_count() const {
     return active_count_;
 }
 
+PafWriter &RealtimePool::get_paf_writer() {
+    return paf_out_;
+}
+
 //void u32 ReadBuffer::end_read(u16 ch, u32 number) {
 //    ch--;
 //    if (!mappers_[ch].finished() && mappers_[ch].get_read()
 //}
 
+//Adds chunks and updates in one call, so clients don't need to loop over
+//individual chunks and results. Decision tags are set in each PAF, which
+//is queued to be written before returning
+std::vector<RealtimePool::Decision> 
+RealtimePool::update_batch(std::vector<Chunk> &chunks, bool eject) {
+
+    float now = chunk_timer_.get();
+    for (Chunk &c : chunks) {
+        if (c.get_device() < PRMS.num_devices) {
+            chunk_times_[get_pool_idx(c)] = now;
+        }
+        add_chunk(c);
+    }
+
+    std::vector<u32> pool_idxs;
+    std::vector<MapResult> results = update_pool(pool_idxs);
+
+    std::vector<Decision> ret;
+    for (u32 i = 0; i < results.size(); i++) {
+        MapResult &r = results[i];
+        u16 ch = std::get<0>(r);
+        Paf &paf = std::get<2>(r);
+        u16 device = pool_idxs[i] / ReadBuffer::PRMS.num_channels;
+
+        bool deplete = get_device_mode(device) == RealtimeParams::Mode::DEPLETE;
+
+        float t = (chunk_timer_.get() - chunk_times_[pool_idxs[i]]) / 1000;
+        Action a;
+
+        if (paf.is_ended()) {
+            paf.set_float(Paf::Tag::ENDED, t);
+            a = Action::ENDED;
+
+        } else if (paf.is_mapped() == deplete) {
+            if (eject) {
+                paf.set_float(Paf::Tag::EJECT, t);
+                a = Action::EJECT;
+            } else {
+                paf.set_float(Paf::Tag::IN_SCAN, t);
+                a = Action::IN_SCAN;
+            }
+
+        } else {
+            paf.set_float(Paf::Tag::KEEP, t);
+            a = Action::KEEP;
+        }
+
+        ret.push_back({ch, std::get<1>(r), a, t, device});
+        paf_out_.write(std::move(paf));
+    }
+
+    return ret;
+}
+
+std::vector<MapResult> RealtimePool::update_mapped() {
+    std::vector<MapResult> ret;
+
+    while (true) {
+        bool mapped = chunks_mapped();
+        for (MapResult &r : update()) {
+            ret.push_back(std::move(r));
+        }
+
+        //update may have assigned buffered chunks or queued reads
+        if (mapped && chunks_mapped()) break;
+
+        //Threads notify once they've mapped all of their signal. The limit
+        //only matters if buffered signal is waiting on a mapper's lock
+        mapped_.wait(10);
+    }
+
+    return ret;
+}
+
+//True if no mapper assigned to a thread has signal left to map
+//Each mapper's thread marks when it has mapped all signal received so far
+bool RealtimePool::chunks_mapped() {
+    queued_.assign(mappers_.size(), false);
+    for (u32 ch : active_queue_) {
+        queued_[ch] = true;
+    }
+
+    for (u32 ch : buffer_queue_) {
+        if (!queued_[ch]) return false;
+    }
+
+    for (u32 ch = 0; ch < mappers_.size(); ch++) {
+        Mapper &m = mappers_[ch];
+        if (!queued_[ch] && m.get_state() == Mapper::State::MAPPING &&
+            (m.is_resetting() || !m.signal_mapped())) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//Sleeps until a read finishes mapping or max_ms passes
+//Returns true if results are ready to be collected by update
+bool RealtimePool::wait_results(float max_ms) {
+    return results_.wait(max_ms);
+}
+
 bool RealtimePool::all_finished() {
     if (!buffer_queue_.empty()) return false;
 
     for (MapperThread &t : threads_) {
-        if (t.read_count() > 0 || !t.out_chs_.empty()) return false;
+        if (t.read_count() > 0 || 
+            !t.out_chs_.empty() || 
+            !t.yield_chs_.empty()) return false;
     }
 
     return true;
@@ -283,26 +495,66 @@ void RealtimePool::stop_all() {
     if (!stopped_) {
         stopped_ = true;
         for (MapperThread &t : threads_) {
+            t.in_mtx_.lock();
+            t.running_ = false;
+            t.in_mtx_.unlock();
+            t.in_cv_.notify_one();
+            t.thread_.join();
+            t.out_chs_.clear();
+            t.yield_chs_.clear();
+        }
+
+        for (SignalThread &t : signal_threads_) {
             t.running_ = false;
+            t.chunks_.notify();
             t.thread_.join();
         }
 
         active_queue_.clear();
         buffer_queue_.clear();
+
+        paf_out_.close();
     }
 }
 
 u16 RealtimePool::MapperThread::num_threads = 0;
 
-RealtimePool::MapperThread::MapperThread(std::vector<Mapper> &mappers)
+RealtimePool::MapperThread::MapperThread(std::vector<Mapper> &mappers, 
+                                         Notifier &results,
+                                         Notifier &mapped,
+                                         std::atomic<u16> &idle_threads,
+                                         const RealtimeParams &prms)
     : tid_(num_threads++),
       mappers_(mappers),
-      running_(true) {}
+      results_(results),
+      mapped_(mapped),
+      idle_threads_(idle_threads),
+      PRMS(prms),
+      running_(true),
+      process_chunks_(true),
+      numa_(false),
+      numa_node_(0),
+      in_chs_(mappers.size()),
+      out_chs_(mappers.size()),
+      yield_chs_(mappers.size()),
+      active_size_(0) {}
 
 RealtimePool::MapperThread::MapperThread(MapperThread &&mt) 
     : tid_(mt.tid_),
       mappers_(mt.mappers_),
-      running_(mt.running_), 
+      results_(mt.results_),
+      mapped_(mt.mapped_),
+      idle_threads_(mt.idle_threads_),
+      PRMS(mt.PRMS),
+      running_(mt.running_.load()), 
+      process_chunks_(mt.process_chunks_),
+      numa_(mt.numa_),
+      numa_node_(mt.numa_node_),
+      in_chs_(mt.in_chs_),
+      out_chs_(mt.out_chs_),
+      yield_chs_(mt.yield_chs_),
+      active_size_(0),
+      arena_(std::move(mt.arena_)),
       thread_(std::move(mt.thread_)) {}
 
 void RealtimePool::MapperThread::start() {
@@ -310,63 +562,84 @@ void RealtimePool::MapperThread::start() {
 }
 
 
-u16 RealtimePool::MapperThread::read_count() const {
-    return in_chs_.size() + active_chs_.size();
+u32 RealtimePool::MapperThread::read_count() const {
+    return in_chs_.size() + active_size_.load(std::memory_order_acquire);
 }
 
 void RealtimePool::MapperThread::run() {
     std::string fast5_id;
     std::vector<float> fast5_signal;
 
-    std::vector<u16> finished;
 
     Timer t;
 
+    if (numa_) Numa::pin_thread(numa_node_);
+
     while (running_) {
         if (read_count() == 0) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            idle_threads_++;
+            std::unique_lock<std::mutex> lock(in_mtx_);
+            in_cv_.wait(lock, [this] {return !in_chs_.empty() || !running_;});
+            idle_threads_--;
             continue;
         }
 
-        //Read inputs (pop, lock, and swap it)
-        if (!in_chs_.empty()) {
+        //Read inputs
+        u32 in_ch;
+        while (in_chs_.pop(in_ch)) {
+            if (numa_) mappers_[in_ch].use_replica(numa_node_);
+            active_chs_.push_back(in_ch);
+        }
+        active_size_.store(active_chs_.size(), std::memory_order_release);
 
+        if (PRMS.schedule == RealtimeParams::Schedule::DEADLINE) {
+            prioritize();
+        }
 
-            in_mtx_.lock();
-            in_tmp_.swap(in_chs_);
-            in_mtx_.unlock();
+        //Set if every channel has mapped all of its signal, and if that
+        //changed during this pass
+        bool idle = true, changed = false;
 
+        //TODO: reads are in here
+        //Map chunks
+        for (u32 i = 0; i < active_chs_.size() && running_; i++) {
+            u32 ch = active_chs_[i];
+            Mapper &m = mappers_[ch];
 
-            for (auto ch : in_tmp_) {
-                active_chs_.push_back(ch);
+            //Failed by add_chunk or shed by prioritize
+            if (m.finished()) {
+                out_tmp_.push_back(i);
+                continue;
             }
 
-            in_tmp_.clear(); //(pop)
-        }
-
-        //TODO: reads are in here
-        //Map chunks
-        for (u16 i = 0; i < active_chs_.size() && running_; i++) {
-            u16 ch = active_chs_[i];
 
+            if (process_chunks_) {
+                m.process_chunk();
+            }
 
-            mappers_[ch].process_chunk();
+            bool was_mapped = m.signal_mapped();
 
-            if (mappers_[ch].map_chunk()) {
+            if (m.map_chunk(arena_)) {
                 out_tmp_.push_back(i);
+                continue;
             }
+
+            bool mapped = m.signal_mapped();
+            changed |= mapped && !was_mapped;
+            idle &= mapped;
         }
 
         //Add finished to output
         if (!out_tmp_.empty()) {
+            changed = true;
 
             t.reset();
 
-            out_mtx_.lock();
+            //Can't fill up, each channel is only in one queue at a time
             for (auto i : out_tmp_) {
-                out_chs_.push_back(active_chs_[i]);
+                mappers_[active_chs_[i]].unload_paths(arena_);
+                out_chs_.push(active_chs_[i]);
             }
-            out_mtx_.unlock();
 
             std::sort(out_tmp_.begin(), out_tmp_.end(),
                       [](u32 a, u32 b) { return a > b; });
@@ -375,16 +648,119 @@ void RealtimePool::MapperThread::run() {
                 active_chs_.pop_back();
             }
             out_tmp_.clear();
+
+            active_size_.store(active_chs_.size(), std::memory_order_release);
+
+            results_.notify();
+        }
+
+        //Give half of the channels back to be reassigned while another
+        //thread is idle. Waits for update to collect the last ones first
+        if (idle_threads_ > 0 && active_chs_.size() > 1 && yield_chs_.empty()) {
+            for (u32 n = active_chs_.size() / 2; n > 0; n--) {
+                mappers_[active_chs_.back()].unload_paths(arena_);
+                yield_chs_.push(active_chs_.back());
+                active_chs_.pop_back();
+            }
+            active_size_.store(active_chs_.size(), std::memory_order_release);
+
+            results_.notify();
+            changed = true;
+        }
+
+        //Lets update_mapped stop waiting without polling the mappers
+        if (idle && changed) {
+            mapped_.notify();
         }
     }
 
+    for (u32 ch : active_chs_) {
+        mappers_[ch].unload_paths(arena_);
+    }
     active_chs_.clear();
-
-    in_mtx_.lock();
+    active_size_.store(0, std::memory_order_release);
     in_chs_.clear();
-    in_mtx_.unlock();
+}
+
+//Orders channels so the most urgent work is mapped first
+//Urgency is how long the oldest unmapped chunk has waited, weighted by the
+//value of a decision. Value is highest early in a read, when ejecting saves
+//the most sequencing, and as seeds start to cluster, when a decision is close
+//If any reads have waited longer than shed_age seconds, gives up on the
+//lowest value of those reads so the thread can catch up
+void RealtimePool::MapperThread::prioritize() {
+    if (active_chs_.size() < 2) return;
+
+    float shed_ms = PRMS.shed_age * 1000, min_value = FLT_MAX;
+    u32 shed_ch = UINT_MAX;
+
+    sched_.clear();
+    for (u32 ch : active_chs_) {
+        Mapper &m = mappers_[ch];
+
+        float age = m.get_pending_age(),
+              value = (1 + m.get_seed_progress()) / 
+                      (m.get_chunk_count() + 1);
+
+        sched_.emplace_back(age * value, ch);
+
+        if (shed_ms > 0 && age > shed_ms && value < min_value) {
+            min_value = value;
+            shed_ch = ch;
+        }
+    }
 
-    out_mtx_.lock();
-    out_chs_.clear();
-    out_mtx_.unlock();
+    std::sort(sched_.begin(), sched_.end(),
+              [](const std::pair<float, u32> &a, 
+                 const std::pair<float, u32> &b) { 
+                  return a.first > b.first; 
+              });
+
+    for (u32 i = 0; i < sched_.size(); i++) {
+        active_chs_[i] = sched_[i].second;
+    }
+
+    if (shed_ch != UINT_MAX) {
+        mappers_[shed_ch].set_failed();
+    }
+}
+
+RealtimePool::SignalThread::SignalThread(std::vector<Mapper> &mappers, 
+                                         u16 tid, u16 stride)
+    : tid_(tid),
+      stride_(stride),
+      mappers_(mappers),
+      running_(true) {}
+
+RealtimePool::SignalThread::SignalThread(SignalThread &&st) 
+    : tid_(st.tid_),
+      stride_(st.stride_),
+      mappers_(st.mappers_),
+      running_(st.running_.load()), 
+      thread_(std::move(st.thread_)) {}
+
+void RealtimePool::SignalThread::start() {
+    thread_ = std::thread(&RealtimePool::SignalThread::run, this);
+}
+
+void RealtimePool::SignalThread::run() {
+    while (running_) {
+        u32 nevents = 0;
+        bool blocked = false;
+
+        for (u32 ch = tid_; ch < mappers_.size() && running_; ch += stride_) {
+            Mapper &m = mappers_[ch];
+            if (m.get_state() == Mapper::State::MAPPING) {
+                nevents += m.process_chunk();
+                blocked |= !m.is_chunk_processed();
+            }
+        }
+
+        if (nevents > 0) continue;
+
+        //Signal left unprocessed is waiting for a mapper thread to empty
+        //its event queue. Otherwise sleeps until add_chunk passes signal
+        //to one of this thread's channels
+        chunks_.wait(blocked ? 1 : 100);
+    }
 }
@@ -27,8 +27,16 @@
 #include <thread>
 #include <vector>
 #include <deque>
+#include <atomic>
+#include <condition_variable>
 #include "mapper.hpp"
+#include "spsc_queue.hpp"
 #include "conf.hpp"
+#include "paf_writer.hpp"
+
+#ifdef PYBIND
+#include <pybind11/numpy.h>
+#endif
 
 using MapResult = std::tuple<u16, u32, Paf>;
 
@@ -41,6 +49,7 @@ class RealtimePool {
     RealtimePool(Conf &conf);
     
     bool add_chunk(Chunk &chunk);
+    u32 add_chunks(std::vector<Chunk> &chunks);
     bool try_add_chunk(Chunk &chunk);
     void end_read(u16 ch, u32 number);
     bool is_read_finished(const ReadBuffer &r);
@@ -48,33 +57,75 @@ class RealtimePool {
     bool is_stopped() {return stopped_;}
 
     std::vector<MapResult> update();
+    bool wait_results(float max_ms);
+
+    //Waits until every chunk added so far has been mapped, then returns
+    //results like update. Reads still queued for a thread aren't waited
+    //for. Used to step ClientSim in virtual time
+    std::vector<MapResult> update_mapped();
+
+    //What the client should do with a finished read
+    enum Action : u8 {KEEP, EJECT, IN_SCAN, ENDED};
+
+    typedef struct {
+        u16 channel;
+        u32 number;
+        Action action;
+        float time; //seconds since the channel's last chunk
+        u16 device;
+    } Decision;
+
+    //PAFs are written by the pool's PafWriter
+    std::vector<Decision> update_batch(std::vector<Chunk> &chunks, bool eject);
     bool all_finished();
     void stop_all(); //TODO: just name stop
 
     u32 active_count() const; 
 
+    //Writer used by update_batch, which clients can share for their
+    //own output so lines aren't interleaved
+    PafWriter &get_paf_writer();
+
+    u32 get_pool_idx(const Chunk &c) const;
+    RealtimeParams::Mode get_device_mode(u16 device) const;
+
     #ifdef PYBIND
 
     #define PY_REALTIME_METH(P) c.def(#P, &RealtimePool::P);
     #define PY_REALTIME_PRM(P) p.def_readwrite(#P, &RealtimeParams::P);
     #define PY_REALTIME_MODE(P) m.value(#P, RealtimeParams::Mode::P);
     #define PY_REALTIME_ACTIVE(P) a.value(#P, RealtimeParams::ActiveChs::P);
+    #define PY_REALTIME_SCHED(P) s.value(#P, RealtimeParams::Schedule::P);
+    #define PY_REALTIME_ACTION(P) d.value(#P, RealtimePool::Action::P);
 
     static void pybind_defs(pybind11::class_<RealtimePool> &c) {
         c.def(pybind11::init<Conf &>());
         PY_REALTIME_METH(add_chunk);
+        c.def("add_chunks", &RealtimePool::add_chunks_py);
+        c.def("update_batch", &RealtimePool::update_batch_py);
         PY_REALTIME_METH(try_add_chunk);
         PY_REALTIME_METH(update);
+        c.def("update_mapped", &RealtimePool::update_mapped, 
+              pybind11::call_guard<pybind11::gil_scoped_release>());
+        c.def("wait_results", &RealtimePool::wait_results, 
+              pybind11::call_guard<pybind11::gil_scoped_release>());
         PY_REALTIME_METH(all_finished);
         PY_REALTIME_METH(stop_all);
+        c.def("get_paf_writer", &RealtimePool::get_paf_writer,
+              pybind11::return_value_policy::reference_internal);
 
         pybind11::class_<RealtimeParams> p(c, "RealtimeParams");
         PY_REALTIME_PRM(host);
         PY_REALTIME_PRM(port);
         PY_REALTIME_PRM(duration);
         PY_REALTIME_PRM(max_active_reads);
+        PY_REALTIME_PRM(signal_threads);
         PY_REALTIME_PRM(active_chs);
         PY_REALTIME_PRM(realtime_mode);
+        PY_REALTIME_PRM(num_devices);
+        PY_REALTIME_PRM(device_modes);
+        PY_REALTIME_PRM(schedule);
+        PY_REALTIME_PRM(shed_age);
 
         pybind11::enum_<RealtimeParams::Mode> m(c, "RealtimeMode");
         PY_REALTIME_MODE(DEPLETE);
@@ -86,6 +137,89 @@ class RealtimePool {
         PY_REALTIME_ACTIVE(EVEN);
         PY_REALTIME_ACTIVE(ODD);
         a.export_values();
+
+        pybind11::enum_<RealtimeParams::Schedule> s(c, "Schedule");
+        PY_REALTIME_SCHED(ROUND_ROBIN);
+        PY_REALTIME_SCHED(DEADLINE);
+        s.export_values();
+
+        pybind11::enum_<RealtimePool::Action> d(c, "Action");
+        PY_REALTIME_ACTION(KEEP);
+        PY_REALTIME_ACTION(EJECT);
+        PY_REALTIME_ACTION(IN_SCAN);
+        PY_REALTIME_ACTION(ENDED);
+        d.export_values();
+    }
+
+    //Reads a list of (id, channel, number, start_sample, raw[, device])
+    //tuples, where raw is an int16, int32, or float32 numpy array or memoryview
+    //Requires the GIL. Signal is copied later by Chunk::set_raw, but is
+    //checked here so invalid buffers raise ValueError
+    static void load_batch_py(pybind11::list batch, 
+                              std::vector<Chunk> &chunks, 
+                              std::vector<pybind11::buffer_info> &raw) {
+        chunks.reserve(batch.size());
+        raw.reserve(batch.size());
+
+        for (u32 i = 0; i < batch.size(); i++) {
+            pybind11::tuple c = batch[i].cast<pybind11::tuple>();
+            chunks.emplace_back(c[0].cast<std::string>(), 
+                                c[1].cast<u16>(), 
+                                c[2].cast<u32>(), 
+                                c[3].cast<u64>());
+            raw.push_back(c[4].cast<pybind11::buffer>().request());
+            Chunk::check_raw(raw.back());
+            if (c.size() > 5) chunks.back().set_device(c[5].cast<u16>());
+        }
+    }
+
+    //Signal is converted and added to the pool with the GIL released
+    static u32 add_chunks_py(RealtimePool &pool, pybind11::list batch) {
+        std::vector<Chunk> chunks;
+        std::vector<pybind11::buffer_info> raw;
+        load_batch_py(batch, chunks, raw);
+
+        pybind11::gil_scoped_release release;
+
+        for (u32 i = 0; i < chunks.size(); i++) {
+            chunks[i].set_raw(raw[i]);
+        }
+        return pool.add_chunks(chunks);
+    }
+
+    //Returns (channels, numbers, actions, times, devices) numpy arrays
+    static pybind11::tuple update_batch_py(RealtimePool &pool, 
+                                           pybind11::list batch, 
+                                           bool eject) {
+        std::vector<Chunk> chunks;
+        std::vector<pybind11::buffer_info> raw;
+        load_batch_py(batch, chunks, raw);
+
+        std::vector<Decision> decisions;
+        {
+            pybind11::gil_scoped_release release;
+
+            for (u32 i = 0; i < chunks.size(); i++) {
+                chunks[i].set_raw(raw[i]);
+            }
+            decisions = pool.update_batch(chunks, eject);
+        }
+
+        pybind11::array_t<u16> channels(decisions.size());
+        pybind11::array_t<u32> numbers(decisions.size());
+        pybind11::array_t<u8> actions(decisions.size());
+        pybind11::array_t<float> times(decisions.size());
+        pybind11::array_t<u16> devices(decisions.size());
+
+        for (u32 i = 0; i < decisions.size(); i++) {
+            channels.mutable_data()[i] = decisions[i].channel;
+            numbers.mutable_data()[i] = decisions[i].number;
+            actions.mutable_data()[i] = decisions[i].action;
+            times.mutable_data()[i] = decisions[i].time;
+            devices.mutable_data()[i] = decisions[i].device;
+        }
+
+        return pybind11::make_tuple(channels, numbers, actions, times, devices);
     }
 
     #endif
@@ -94,46 +228,128 @@ class RealtimePool {
 
     class MapperThread {
         public:
-        MapperThread(std::vector<Mapper> &mappers);
+        MapperThread(std::vector<Mapper> &mappers, 
+                     Notifier &results, 
+                     Notifier &mapped,
+                     std::atomic<u16> &idle_threads,
+                     const RealtimeParams &prms);
         MapperThread(MapperThread &&mt);
 
         void start();
         void stop();
 
         void run();
+        void prioritize();
 
-        u16 read_count() const;
+        u32 read_count() const;
 
         static u16 num_threads;
         u16 tid_;
 
         std::vector<Mapper> &mappers_;
+        Notifier &results_, &mapped_;
+        std::atomic<u16> &idle_threads_;
+        const RealtimeParams &PRMS;
+
+        //Cleared by stop_all while the thread is running
+        std::atomic<bool> running_;
+
+        //False if chunks are processed by a SignalThread
+        bool process_chunks_;
+
+        //If numa_ is set the thread runs on numa_node_ and maps its
+        //channels with that node's index replica
+        bool numa_;
+        u16 numa_node_;
+
+        //Channels assigned by update and finished channels returned to it
+        //Lock-free so update never waits on a busy thread
+        SpscQueue<u32> in_chs_, out_chs_;
+
+        //Unfinished channels given back for update to reassign when
+        //another thread is idle, so idle threads take over queued work
+        SpscQueue<u32> yield_chs_;
+
+        std::vector<u32> active_chs_, out_tmp_;
+
+        //(priority, channel) pairs used by prioritize
+        std::vector< std::pair<float, u32> > sched_;
+
+        //Size of active_chs_, which is only accessed by this thread
+        std::atomic<u32> active_size_;
 
-        bool running_;
+        //Search buffers shared by all channels mapped by this thread
+        Mapper::PathArena arena_;
 
-        //Corrasponding inputs/output
-        std::vector< u16 > in_chs_, in_tmp_, 
-                           out_chs_, out_tmp_,
-                           active_chs_;
-        std::mutex in_mtx_, out_mtx_;
+        //Signaled when reads are assigned to an idle thread
+        std::mutex in_mtx_;
+        std::condition_variable in_cv_;
 
         std::thread thread_;
 
         float mtx_time_;
     };
 
+    //Optional signal processing stage
+    //Detects and normalizes events for a fixed subset of channels,
+    //which are passed to the MapperThreads via each Mapper's event queue
+    class SignalThread {
+        public:
+        SignalThread(std::vector<Mapper> &mappers, u16 tid, u16 stride);
+        SignalThread(SignalThread &&st);
+
+        void start();
+        void run();
+
+        u16 tid_, stride_;
+
+        std::vector<Mapper> &mappers_;
+
+        std::atomic<bool> running_;
+
+        //Signaled when one of the thread's channels receives signal
+        Notifier chunks_;
+
+        std::thread thread_;
+    };
+
     void buffer_chunk(Chunk &c);
 
+    //Wakes the signal thread which processes the channel, if any
+    void notify_signal(u32 ch);
+
+    std::vector<MapResult> update_pool(std::vector<u32> &pool_idxs);
+
+    bool chunks_mapped();
+
     bool stopped_;
 
+    //Number of mapper threads waiting for reads
+    std::atomic<u16> idle_threads_;
+
     u32 active_count_;
 
-    //List of mappers - one for each channel
+    //List of mappers - one for each channel of each device
     std::vector<Mapper> mappers_;
     std::vector<MapperThread> threads_;
+    std::vector<SignalThread> signal_threads_;
     std::vector<Chunk> chunk_buffer_;
 
-    std::vector<u16> buffer_queue_, out_chs_, active_queue_;
+    //Time each channel last received a chunk through update_batch
+    std::vector<float> chunk_times_;
+    Timer chunk_timer_;
+    PafWriter paf_out_;
+
+    std::vector<u32> buffer_queue_, active_queue_;
+
+    //Marks channels in active_queue_, used by chunks_mapped
+    std::vector<bool> queued_;
+
+    //Signaled by mapper threads when reads finish
+    Notifier results_;
+
+    //Signaled by mapper threads when they have mapped all of their signal
+    Notifier mapped_;
     //std::deque<u16> ;
     //std::vector<u16> active_queue_;
 
@@ -0,0 +1,331 @@
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <algorithm>
+#include <unistd.h>
+#include "conf.hpp"
+#include "realtime_pool.hpp"
+#include "signal_gen.hpp"
+#include "spsc_queue.hpp"
+
+//Stress test and benchmark for the realtime thread hand-off
+//
+//  realtime_test spsc [-n values]
+//      Passes a counting sequence through small SpscQueues, mixing single
+//      and batched pushes and pops, and checks nothing is lost or reordered
+//
+//  realtime_test pool [-t threads] [-s signal_threads] [-c channels]
+//                     [-d seconds] [-i chunk_ms] [-g reads] [-D] bwa_prefix
+//      Streams synthetic reads into a RealtimePool, checks every result
+//      belongs to a read that was started and is only returned once, and
+//      prints decision latency, throughput, startup time and memory use
+//
+//Build with "make tsan" to run either mode under ThreadSanitizer
+
+//Resident memory in MB, 0 if unknown
+float rss_mb() {
+    std::ifstream status("/proc/self/status");
+    std::string key;
+    u64 kb;
+    while (status >> key) {
+        if (key == "VmRSS:") {
+            status >> kb;
+            return kb / 1024.0;
+        }
+        status.ignore(1024, '\n');
+    }
+    return 0;
+}
+
+float percentile(std::vector<float> &vals, float p) {
+    if (vals.empty()) return 0;
+    u32 i = (u32) (p * (vals.size()-1));
+    std::nth_element(vals.begin(), vals.begin() + i, vals.end());
+    return vals[i];
+}
+
+float mean(const std::vector<float> &vals) {
+    if (vals.empty()) return 0;
+    double sum = 0;
+    for (float v : vals) sum += v;
+    return sum / vals.size();
+}
+
+//Checks one queue of the given capacity, returns the number of errors
+u32 spsc_test(u32 capacity, u32 count) {
+    SpscQueue<u32> queue(capacity);
+    u32 errors = 0;
+
+    std::thread producer([&] {
+        std::vector<u32> batch;
+        u32 next = 0, n = 1;
+        while (next < count) {
+            //Alternate single values with batches of 1-17
+            if (n % 2 == 0) {
+                if (queue.push(next)) next++;
+                else std::this_thread::yield();
+            } else {
+                batch.clear();
+                for (u32 i = 0; i < n % 17 + 1 && next + i < count; i++) {
+                    batch.push_back(next + i);
+                }
+                u32 pushed = queue.push(batch.data(), batch.size());
+                next += pushed;
+                if (pushed == 0) std::this_thread::yield();
+            }
+            n++;
+        }
+    });
+
+    std::vector<u32> vals;
+    u32 expect = 0, n = 0;
+    while (expect < count) {
+        vals.clear();
+        if (n++ % 2 == 0) {
+            u32 v;
+            if (queue.pop(v)) vals.push_back(v);
+        } else {
+            queue.pop_all(vals);
+        }
+
+        if (vals.empty()) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        for (u32 v : vals) {
+            if (v != expect) {
+                if (errors++ < 10) {
+                    std::cerr << "Error: capacity " << capacity
+                              << " expected " << expect
+                              << " got " << v << "\n";
+                }
+                expect = v;
+            }
+            expect++;
+        }
+
+        if (queue.size() > queue.capacity()) errors++;
+    }
+
+    producer.join();
+
+    if (!queue.empty()) errors++;
+
+    return errors;
+}
+
+int run_spsc(int argc, char **argv) {
+    u32 count = 2000000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+            case 'n':
+                count = atoi(optarg);
+                break;
+            default:
+                std::cerr << "Error: unknown flag\n";
+                return 1;
+        }
+    }
+
+    u32 errors = 0;
+    for (u32 capacity : {1, 3, 16, 1024}) {
+        Timer t;
+        u32 e = spsc_test(capacity, count);
+        std::cout << "spsc capacity " << capacity
+                  << "\t" << (count / t.get()) << " values/ms"
+                  << "\t" << e << " errors\n";
+        errors += e;
+    }
+
+    return errors > 0;
+}
+
+//Read currently streaming into one channel
+typedef struct {
+    u32 read, number, chunk, chunk_count;
+    float next_due, last_chunk;
+    std::vector<bool> returned;
+} Channel;
+
+int run_pool(int argc, char **argv) {
+    Conf conf;
+    u32 nchannels = 512, nreads = 2000;
+    float duration = 30, chunk_ms = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:s:c:d:i:g:D")) != -1) {
+        switch (opt) {
+            case 't':
+                conf.set_threads(atoi(optarg));
+                break;
+            case 's':
+                conf.set_signal_threads(atoi(optarg));
+                break;
+            case 'c':
+                nchannels = atoi(optarg);
+                break;
+            case 'd':
+                duration = atof(optarg);
+                break;
+            case 'i':
+                chunk_ms = atof(optarg);
+                break;
+            case 'g':
+                nreads = atoi(optarg);
+                break;
+            case 'D':
+                conf.set_schedule(RealtimeParams::Schedule::DEADLINE);
+                break;
+            default:
+                std::cerr << "Error: unknown flag\n";
+                return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        std::cerr << "Error: must specify bwa_prefix\n";
+        return 1;
+    }
+    conf.set_bwa_prefix(argv[optind]);
+    conf.set_num_channels(nchannels);
+    conf.set_max_active_reads(nchannels);
+
+    u32 chunk_len = ReadBuffer::PRMS.chunk_len();
+    if (chunk_ms <= 0) chunk_ms = conf.get_chunk_time() * 1000;
+
+    std::cerr << "Generating " << nreads << " reads\n";
+    SignalGen::Params gen_prms = SignalGen::PRMS_DEF;
+    gen_prms.gen_reads = nreads;
+    SignalGen gen(gen_prms, conf.get_bwa_prefix());
+
+    std::vector<ReadBuffer> reads;
+    for (u32 i = 0; i < nreads; i++) {
+        reads.push_back(gen.get_read(i));
+    }
+
+    float rss_start = rss_mb();
+    Timer t;
+    RealtimePool pool(conf);
+    float startup = t.lap(),
+          rss_pool = rss_mb();
+
+    //Channels start evenly spread over one chunk interval
+    std::vector<Channel> channels(nchannels);
+    for (u32 c = 0; c < nchannels; c++) {
+        Channel &ch = channels[c];
+        ch.read = c % nreads;
+        ch.number = 1;
+        ch.chunk = 0;
+        ch.chunk_count = (reads[ch.read].size() + chunk_len - 1) / chunk_len;
+        ch.next_due = chunk_ms * c / nchannels;
+        ch.last_chunk = 0;
+        ch.returned.assign(2, false);
+    }
+
+    u32 next_read = nchannels, chunks = 0, results = 0, mapped = 0,
+        errors = 0;
+    std::vector<float> latencies, update_times;
+
+    auto next_number = [&](Channel &ch) {
+        ch.read = next_read++ % nreads;
+        ch.number++;
+        ch.chunk = 0;
+        ch.chunk_count = (reads[ch.read].size() + chunk_len - 1) / chunk_len;
+        ch.returned.push_back(false);
+    };
+
+    float end = duration * 1000;
+    while (t.get() < end) {
+        float now = t.get(), next_due = end;
+
+        for (u32 c = 0; c < nchannels; c++) {
+            Channel &ch = channels[c];
+            if (ch.next_due <= now) {
+                if (ch.chunk >= ch.chunk_count) next_number(ch);
+
+                const ReadBuffer &r = reads[ch.read];
+                Chunk chunk(r.get_id(), c+1, ch.number, ch.chunk * chunk_len,
+                            r.get_raw(), ch.chunk * chunk_len, chunk_len);
+                pool.add_chunk(chunk);
+
+                ch.chunk++;
+                ch.last_chunk = now;
+                ch.next_due += chunk_ms;
+                chunks++;
+            }
+            next_due = std::min(next_due, ch.next_due);
+        }
+
+        Timer ut;
+        std::vector<MapResult> res = pool.update();
+        update_times.push_back(ut.get());
+
+        for (MapResult &m : res) {
+            u16 c = std::get<0>(m) - 1;
+            u32 number = std::get<1>(m);
+            Paf &paf = std::get<2>(m);
+
+            if (c >= nchannels || number == 0 ||
+                number > channels[c].number ||
+                channels[c].returned[number]) {
+
+                if (errors++ < 10) {
+                    std::cerr << "Error: unexpected result for channel "
+                              << (c+1) << " read " << number << "\n";
+                }
+                continue;
+            }
+
+            Channel &ch = channels[c];
+            ch.returned[number] = true;
+            results++;
+            mapped += paf.is_mapped();
+
+            //Decided before the read ended, so it would be ejected or kept
+            if (number == ch.number) {
+                latencies.push_back(t.get() - ch.last_chunk);
+                next_number(ch);
+            }
+        }
+
+        float wait = next_due - t.get();
+        if (wait > 0) pool.wait_results(wait);
+    }
+
+    float elapsed = t.get();
+    pool.stop_all();
+
+    std::cout << "channels\t" << nchannels << "\n"
+              << "threads\t" << conf.get_threads() << "\n"
+              << "signal_threads\t" << conf.get_signal_threads() << "\n"
+              << "startup_ms\t" << startup << "\n"
+              << "rss_start_mb\t" << rss_start << "\n"
+              << "rss_pool_mb\t" << rss_pool << "\n"
+              << "rss_end_mb\t" << rss_mb() << "\n"
+              << "chunks\t" << chunks << "\n"
+              << "chunks_per_sec\t" << (chunks / (elapsed / 1000)) << "\n"
+              << "results\t" << results << "\n"
+              << "mapped\t" << mapped << "\n"
+              << "decisions\t" << latencies.size() << "\n"
+              << "latency_mean_ms\t" << mean(latencies) << "\n"
+              << "latency_p50_ms\t" << percentile(latencies, 0.5) << "\n"
+              << "latency_p99_ms\t" << percentile(latencies, 0.99) << "\n"
+              << "update_mean_ms\t" << mean(update_times) << "\n"
+              << "update_p99_ms\t" << percentile(update_times, 0.99) << "\n"
+              << "errors\t" << errors << "\n";
+
+    return errors > 0;
+}
+
+int main(int argc, char **argv) {
+    std::string mode = argc > 1 ? argv[1] : "";
+
+    if (mode == "spsc") return run_spsc(argc-1, argv+1);
+    if (mode == "pool") return run_pool(argc-1, argv+1);
+
+    std::cerr << "Usage: realtime_test spsc|pool [options]\n";
+    return 1;
+}
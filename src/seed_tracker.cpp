@@ -150,6 +150,13 @@ float SeedTracker::get_top_conf() {
     return (float) max_map_.total_len_ / (*std::next(all_lens_.rbegin()));
 }
 
+//How close the best cluster is to a confident mapping, from 0 to 1
+float SeedTracker::get_progress() {
+    if (max_map_.total_len_ == 0 || all_lens_.size() < 2) return 0;
+    float p = get_top_conf() / PRMS.min_top_conf;
+    return p < 1 ? p : 1;
+}
+
 float SeedTracker::get_mean_conf() {
     return max_map_.total_len_ / (len_sum_ / seed_clusters_.size());
 }
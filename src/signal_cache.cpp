@@ -0,0 +1,194 @@
+/* MIT License
+ *
+ * Copyright (c) 2018 Sam Kovaka <skovaka@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "signal_cache.hpp"
+#include "fast5_reader.hpp"
+
+const std::string SignalCache::SUFFIX = ".usig";
+const char SignalCache::MAGIC[8] = {'U','N','C','L','S','I','G','\0'};
+
+bool SignalCache::is_cache(const std::string &fname) {
+    return fname.size() >= SUFFIX.size() && 
+           fname.compare(fname.size()-SUFFIX.size(), SUFFIX.size(), SUFFIX) == 0;
+}
+
+//Signal is written as it's loaded, followed by the metadata table.
+//The header is rewritten at the end with the final counts
+u32 SignalCache::build(Fast5Reader &fast5s, const std::string &fname) {
+    std::ofstream out(fname, std::ios::binary);
+
+    if (!out.is_open()) {
+        std::cerr << "Error: failed to open signal cache \""
+                  << fname << "\"\n";
+        return 0;
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(Header));
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    out.write((const char *) &header, sizeof(Header));
+
+    std::vector<ReadMeta> metas;
+    std::vector<i16> raw;
+
+    while (!fast5s.empty()) {
+        ReadBuffer read = fast5s.pop_read();
+        if (read.empty()) continue;
+
+        if (read.get_id().size() >= sizeof(ReadMeta::id)) {
+            std::cerr << "Warning: skipping read with long ID \"" 
+                      << read.get_id() << "\"\n";
+            continue;
+        }
+
+        ReadMeta m;
+        memset(&m, 0, sizeof(ReadMeta));
+        strcpy(m.id, read.get_id().c_str());
+        m.start_sample = read.get_start();
+        m.signal_offs = header.sample_count;
+        m.number = read.get_number();
+        m.length = read.size();
+        m.cal_digit = read.cal_digit_;
+        m.cal_range = read.cal_range_;
+        m.cal_offset = read.cal_offset_;
+        m.channel = read.get_channel();
+
+        //Reverses calibration to store the original samples
+        const std::vector<float> &sig = read.get_raw();
+        raw.resize(sig.size());
+        for (u32 i = 0; i < sig.size(); i++) {
+            raw[i] = (i16) lround((sig[i] - m.cal_offset) * m.cal_digit / m.cal_range);
+        }
+        out.write((const char *) raw.data(), raw.size() * sizeof(i16));
+
+        header.sample_count += raw.size();
+        metas.push_back(m);
+
+        if (metas.size() % 1000 == 0) {
+            std::cerr << metas.size() << " cached\n";
+        }
+    }
+
+    //Keeps the table aligned
+    if (header.sample_count % 4 != 0) {
+        u64 pad = 4 - (header.sample_count % 4);
+        raw.assign(pad, 0);
+        out.write((const char *) raw.data(), pad * sizeof(i16));
+        header.sample_count += pad;
+    }
+
+    header.read_count = metas.size();
+    header.meta_offs = sizeof(Header) + header.sample_count * sizeof(i16);
+    out.write((const char *) metas.data(), metas.size() * sizeof(ReadMeta));
+
+    out.seekp(0);
+    out.write((const char *) &header, sizeof(Header));
+
+    return header.read_count;
+}
+
+SignalCache::SignalCache() 
+    : data_(NULL),
+      data_len_(0),
+      read_count_(0),
+      meta_(NULL),
+      signal_(NULL) {}
+
+SignalCache::~SignalCache() {
+    close();
+}
+
+bool SignalCache::open(const std::string &fname) {
+    if (is_open()) close();
+
+    int fd = ::open(fname.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: failed to open signal cache \""
+                  << fname << "\"\n";
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(Header)) {
+        data_len_ = st.st_size;
+        data_ = mmap(NULL, data_len_, PROT_READ, MAP_SHARED, fd, 0);
+        if (data_ == MAP_FAILED) data_ = NULL;
+    }
+    ::close(fd);
+
+    const Header *h = (const Header *) data_;
+    if (h == NULL || memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0 || 
+        h->version != VERSION || 
+        h->meta_offs + h->read_count * sizeof(ReadMeta) > data_len_) {
+
+        std::cerr << "Error: \"" << fname << "\" is not a valid signal cache\n";
+        close();
+        return false;
+    }
+
+    read_count_ = h->read_count;
+    signal_ = (const i16 *) ((const char *) data_ + sizeof(Header));
+    meta_ = (const ReadMeta *) ((const char *) data_ + h->meta_offs);
+
+    read_idxs_.reserve(read_count_);
+    for (u32 i = 0; i < read_count_; i++) {
+        read_idxs_[meta_[i].id] = i;
+    }
+
+    return true;
+}
+
+bool SignalCache::is_open() const {
+    return data_ != NULL;
+}
+
+void SignalCache::close() {
+    if (data_ != NULL) munmap(data_, data_len_);
+    data_ = NULL;
+    data_len_ = 0;
+    read_count_ = 0;
+    meta_ = NULL;
+    signal_ = NULL;
+    read_idxs_.clear();
+}
+
+u32 SignalCache::find(const std::string &read_id) const {
+    auto i = read_idxs_.find(read_id);
+    if (i == read_idxs_.end()) return read_count_;
+    return i->second;
+}
+
+ReadBuffer SignalCache::get_read(u32 i) const {
+    const ReadMeta &m = meta_[i];
+    std::vector<i16> raw(get_signal(i), get_signal(i) + m.length);
+    return ReadBuffer(m.id, m.channel, m.number, m.start_sample, raw,
+                      m.cal_digit, m.cal_range, m.cal_offset);
+}
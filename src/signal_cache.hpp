@@ -0,0 +1,109 @@
+/* MIT License
+ *
+ * Copyright (c) 2018 Sam Kovaka <skovaka@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _INCL_SIGNAL_CACHE
+#define _INCL_SIGNAL_CACHE
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "read_buffer.hpp"
+#include "util.hpp"
+
+#ifdef PYBIND
+#include <pybind11/pybind11.h>
+#endif
+
+class Fast5Reader;
+
+//Raw signal of a set of reads stored as int16 samples with a fixed-size
+//metadata table, written once from fast5/slow5 files. The file is memory
+//mapped read-only, so it can be shared by concurrent processes and reads
+//can be accessed without copying or decoding
+class SignalCache {
+    public:
+
+    static const std::string SUFFIX;
+
+    typedef struct {
+        char id[48];
+        u64 start_sample, signal_offs;
+        u32 number, length;
+        float cal_digit, cal_range, cal_offset;
+        u16 channel, pad_;
+    } ReadMeta;
+
+    //Writes all reads loaded by a Fast5Reader to a cache file
+    //Returns the number of reads written
+    static u32 build(Fast5Reader &fast5s, const std::string &fname);
+
+    static bool is_cache(const std::string &fname);
+
+    SignalCache();
+    SignalCache(const SignalCache &c) = delete;
+    ~SignalCache();
+
+    bool open(const std::string &fname);
+    bool is_open() const;
+    void close();
+
+    u32 size() const {return read_count_;}
+    const ReadMeta &get_meta(u32 i) const {return meta_[i];}
+    const i16 *get_signal(u32 i) const {return signal_ + meta_[i].signal_offs;}
+
+    //Index of a read ID, or size() if not present
+    u32 find(const std::string &read_id) const;
+
+    //Copies and calibrates a read
+    ReadBuffer get_read(u32 i) const;
+
+    #ifdef PYBIND
+
+    static void pybind_defs(pybind11::class_<SignalCache> &c) {
+        c.def_static("build", &SignalCache::build);
+        c.def_static("is_cache", &SignalCache::is_cache);
+        c.attr("SUFFIX") = SUFFIX;
+    }
+
+    #endif
+
+    private:
+
+    typedef struct {
+        char magic[8];
+        u32 version, read_count;
+        u64 sample_count, meta_offs;
+    } Header;
+
+    static const char MAGIC[8];
+    static const u32 VERSION = 1;
+
+    void *data_;
+    size_t data_len_;
+    u32 read_count_;
+    const ReadMeta *meta_;
+    const i16 *signal_;
+    std::unordered_map<std::string, u32> read_idxs_;
+};
+
+#endif
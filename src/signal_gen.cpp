@@ -0,0 +1,267 @@
+/* MIT License
+ *
+ * Copyright (c) 2018 Sam Kovaka <skovaka@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cmath>
+#include <climits>
+#include <random>
+#include <algorithm>
+#include "signal_gen.hpp"
+#include "model_r94.inl"
+
+const SignalGen::Params SignalGen::PRMS_DEF = {
+    gen_reads     : 0,
+    gen_seed      : 0,
+    min_read_len  : 2000,
+    max_read_len  : 20000,
+    unmapped_frac : 0,
+    dwell_shape   : 4.0,
+    stay_prob     : 0.1,
+    skip_prob     : 0.05,
+    level_noise   : 1.0,
+    sample_noise  : 1.5,
+    scale_stdv    : 0.05,
+    shift_stdv    : 5.0,
+    drift         : 0,
+    read_gap      : 1.0
+};
+
+const std::string SignalGen::PREFIX = "signal_gen:";
+
+//Typical MinION channel calibration
+const float SignalGen::CAL_DIGIT  = 8192,
+            SignalGen::CAL_RANGE  = 1402.882,
+            SignalGen::CAL_OFFSET = 10;
+
+//Distributions are implemented here rather than using <random>, whose
+//distributions may differ between standard libraries
+class SignalGen::Rng {
+    public:
+
+    Rng(u32 seed, u32 i) {
+        //splitmix64, so consecutive reads get unrelated streams
+        u64 z = (((u64) seed << 32) | i) + 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        gen_.seed(z ^ (z >> 31));
+    }
+
+    //In [0,1)
+    double uniform() {
+        return (gen_() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    double normal() {
+        double u1 = 1.0 - uniform(), u2 = uniform();
+        return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+    }
+
+    //Marsaglia and Tsang's method, with mean shape
+    double gamma(double shape) {
+        if (shape < 1) {
+            return gamma(shape + 1) * pow(1.0 - uniform(), 1.0 / shape);
+        }
+
+        double d = shape - 1.0 / 3.0, 
+               c = 1.0 / sqrt(9.0 * d);
+        while (true) {
+            double x, v;
+            do {
+                x = normal();
+                v = 1.0 + c * x;
+            } while (v <= 0);
+            v = v * v * v;
+
+            double u = 1.0 - uniform();
+            if (log(u) < 0.5 * x * x + d - d * v + d * log(v)) return d * v;
+        }
+    }
+
+    private:
+    std::mt19937_64 gen_;
+};
+
+SignalGen::SignalGen(const Params &p, const std::string &bwa_prefix) 
+    : PRMS(p) {
+
+    if (PRMS.min_read_len < (u32) KLEN) PRMS.min_read_len = KLEN;
+    if (PRMS.max_read_len < PRMS.min_read_len) {
+        PRMS.max_read_len = PRMS.min_read_len;
+    }
+
+    if (!bwa_prefix.empty()) {
+        index_.load_seqs(bwa_prefix);
+
+        u64 end = 0;
+        for (auto &seq : index_.get_seqs()) {
+            ref_names_.push_back(seq.first);
+            ref_offs_.push_back(index_.coord_to_pacseq(seq.first, 0));
+            ref_lens_.push_back(seq.second);
+            end += seq.second;
+            ref_ends_.push_back(end);
+        }
+    }
+
+    ReadBuffer::Params &read_prms = ReadBuffer::PRMS;
+    num_channels_ = read_prms.num_channels;
+    mean_dwell_ = read_prms.sample_rate / read_prms.bp_per_sec;
+    gap_len_ = (u32) (PRMS.read_gap * read_prms.sample_rate);
+    max_samples_ = (u64) read_prms.max_chunks * read_prms.chunk_len();
+
+    u64 read_len = (u64) ceil(PRMS.max_read_len * mean_dwell_ * (1 + PRMS.stay_prob));
+    slot_len_ = std::min(read_len, max_samples_) + gap_len_;
+}
+
+SignalGen::~SignalGen() {
+    index_.destroy();
+}
+
+//Draws the length and source of a read, always the first values drawn 
+//for a read so IDs can be found without generating signal
+SignalGen::Segment SignalGen::get_segment(Rng &rng) const {
+    Segment s;
+    s.len = PRMS.min_read_len + 
+            (u32) (rng.uniform() * (PRMS.max_read_len - PRMS.min_read_len + 1));
+    s.rid = -1;
+    s.loc = 0;
+    s.fwd = true;
+
+    if (ref_ends_.empty() || rng.uniform() < PRMS.unmapped_frac) {
+        return s;
+    }
+
+    //Reference sequences are chosen in proportion to their length
+    u64 pos = (u64) (rng.uniform() * ref_ends_.back());
+    s.rid = std::upper_bound(ref_ends_.begin(), ref_ends_.end(), pos) 
+            - ref_ends_.begin();
+    s.fwd = rng.uniform() < 0.5;
+
+    u64 ref_len = ref_lens_[s.rid];
+    if (ref_len <= s.len) {
+        s.len = ref_len;
+    } else {
+        s.loc = std::min(pos - (ref_ends_[s.rid] - ref_len), ref_len - s.len);
+    }
+
+    return s;
+}
+
+std::string SignalGen::get_id(u32 i) const {
+    Rng rng(PRMS.gen_seed, i);
+    return segment_id(i, get_segment(rng));
+}
+
+std::string SignalGen::segment_id(u32 i, const Segment &s) const {
+    std::string id = "gen" + std::to_string(i) + "_";
+    if (s.rid < 0) return id + "unmapped";
+
+    std::string loc = "_" + std::to_string(s.loc) + (s.fwd ? "+" : "-");
+
+    //Long reference names are replaced by their index, so IDs fit in a 
+    //SignalCache and are stored in Paf without allocation
+    if (id.size() + ref_names_[s.rid].size() + loc.size() <= Paf::RD_NAME_LEN) {
+        return id + ref_names_[s.rid] + loc;
+    }
+    return id + "ref" + std::to_string(s.rid) + loc;
+}
+
+u16 SignalGen::get_channel(u32 i) const {
+    return (i % num_channels_) + 1;
+}
+
+u32 SignalGen::get_number(u32 i) const {
+    return i / num_channels_;
+}
+
+u64 SignalGen::get_start(u32 i) const {
+    return get_number(i) * slot_len_;
+}
+
+ReadBuffer SignalGen::get_read(u32 i) const {
+    Rng rng(PRMS.gen_seed, i);
+    Segment s = get_segment(rng);
+
+    std::vector<u16> kmers;
+    if (s.rid >= 0) {
+        u64 st = ref_offs_[s.rid] + s.loc;
+        kmers = index_.get_kmers(st, st + s.len);
+        if (!s.fwd) kmers = kmers_revcomp<KLEN>(kmers);
+    } else if (s.len >= (u32) KLEN) {
+        kmers.reserve(s.len - KLEN + 1);
+        u16 kmer = 0;
+        for (u32 j = 0; j < s.len; j++) {
+            kmer = kmer_neighbor<KLEN>(kmer, (u8) (rng.uniform() * 4));
+            if (j + 1 >= (u32) KLEN) kmers.push_back(kmer);
+        }
+    }
+
+    const PoreModel<KLEN> &model = pmodel_r94_template;
+
+    float scale = 1 + PRMS.scale_stdv * rng.normal(),
+          shift = PRMS.shift_stdv * rng.normal(),
+          drift = PRMS.drift / ReadBuffer::PRMS.sample_rate,
+          dwell_scale = mean_dwell_ / PRMS.dwell_shape,
+          digit_per_pa = CAL_DIGIT / CAL_RANGE;
+
+    std::vector<i16> raw;
+    raw.reserve(std::min((u64) (kmers.size() * mean_dwell_ * (1 + PRMS.stay_prob)), 
+                         max_samples_));
+
+    //Signal past max_chunks would be truncated by ReadBuffer
+    for (u32 j = 0; j < kmers.size() && raw.size() < max_samples_; j++) {
+        u16 k = kmers[j];
+        if (rng.uniform() < PRMS.skip_prob) continue;
+
+        do {
+            u32 dwell = std::max(1L, lround(rng.gamma(PRMS.dwell_shape) * dwell_scale));
+            float level = scale * (model.get_mean(k) + 
+                                   PRMS.level_noise * model.get_stdv(k) * rng.normal()) 
+                        + shift;
+
+            for (u32 d = 0; d < dwell; d++) {
+                float pa = level + drift * raw.size() + PRMS.sample_noise * rng.normal();
+                long r = lround((pa - CAL_OFFSET) * digit_per_pa);
+                raw.push_back((i16) std::max((long) SHRT_MIN, std::min((long) SHRT_MAX, r)));
+            }
+        } while (rng.uniform() < PRMS.stay_prob);
+    }
+
+    return ReadBuffer(segment_id(i, s), get_channel(i), get_number(i), get_start(i), 
+                      raw, CAL_DIGIT, CAL_RANGE, CAL_OFFSET);
+}
+
+std::vector<std::string> SignalGen::list_files() const {
+    std::vector<std::string> fnames;
+    for (u32 i = 0; i < size(); i += FILE_READS) {
+        fnames.push_back(PREFIX + std::to_string(i));
+    }
+    return fnames;
+}
+
+bool SignalGen::is_gen(const std::string &fname) {
+    return fname.compare(0, PREFIX.size(), PREFIX) == 0;
+}
+
+void SignalGen::file_reads(const std::string &fname, u32 &start, u32 &end) const {
+    start = atoi(fname.c_str() + PREFIX.size());
+    end = std::min(start + FILE_READS, size());
+}
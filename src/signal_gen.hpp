@@ -0,0 +1,191 @@
+/* MIT License
+ *
+ * Copyright (c) 2018 Sam Kovaka <skovaka@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _INCL_SIGNAL_GEN
+#define _INCL_SIGNAL_GEN
+
+#include <string>
+#include <vector>
+#include "mapper.hpp"
+#include "read_buffer.hpp"
+#include "util.hpp"
+
+#ifdef PYBIND
+#include <pybind11/pybind11.h>
+#endif
+
+//Generates synthetic raw signal from the pore model, either from segments
+//of a reference or from random sequence. Each read only depends on the
+//parameters and its index, so reads can be generated in any order by any
+//number of threads, and the same reads are produced on every machine
+class SignalGen {
+    public:
+
+    typedef struct {
+        u32 gen_reads, gen_seed;
+        u32 min_read_len, max_read_len;
+        float unmapped_frac;
+        float dwell_shape, stay_prob, skip_prob;
+        float level_noise, sample_noise;
+        float scale_stdv, shift_stdv, drift;
+        float read_gap;
+    } Params;
+    static Params const PRMS_DEF;
+
+    typedef struct {
+        const char *gen_reads, *gen_seed, *min_read_len, *max_read_len,
+                   *unmapped_frac, *dwell_shape, *stay_prob, *skip_prob,
+                   *level_noise, *sample_noise, *scale_stdv, *shift_stdv,
+                   *drift, *read_gap;
+    } Docstrs;
+    static constexpr Docstrs DOCSTRS = {
+        gen_reads : 
+            "Number of synthetic reads to generate.",
+        gen_seed : 
+            "Random seed of synthetic reads. Reads only depend on the seed, their index, and the other generator parameters.",
+        min_read_len : 
+            "Minimum synthetic read length in bases.",
+        max_read_len : 
+            "Maximum synthetic read length in bases. Lengths are uniformly distributed.",
+        unmapped_frac : 
+            "Fraction of synthetic reads generated from random sequence instead of the reference.",
+        dwell_shape : 
+            "Shape of the gamma distribution of samples per base. The mean is set by the sample rate and bases per second, higher values give more uniform dwell times.",
+        stay_prob : 
+            "Probability that a k-mer is repeated as an extra event.",
+        skip_prob : 
+            "Probability that a k-mer is skipped.",
+        level_noise : 
+            "Standard deviation of event levels, relative to the pore model standard deviation of each k-mer.",
+        sample_noise : 
+            "Standard deviation in pA of the noise added to each sample.",
+        scale_stdv : 
+            "Standard deviation of the per-read signal scale, which has mean 1.",
+        shift_stdv : 
+            "Standard deviation in pA of the per-read signal shift.",
+        drift : 
+            "Signal drift in pA per second.",
+        read_gap : 
+            "Time in seconds between synthetic reads on a channel."
+    };
+
+    //Pseudo-file names listed by list_files start with this prefix
+    static const std::string PREFIX;
+    static const u32 FILE_READS = 1000;
+
+    //Reads are only generated from random sequence if bwa_prefix is empty.
+    //Only the .ann, .amb, and .pac files of the index are loaded
+    SignalGen(const Params &p, const std::string &bwa_prefix="");
+    SignalGen(const SignalGen &g) = delete;
+    ~SignalGen();
+
+    u32 size() const {return PRMS.gen_reads;}
+
+    //Encodes the source location of reference reads
+    std::string get_id(u32 i) const;
+    u16 get_channel(u32 i) const;
+    u32 get_number(u32 i) const;
+    u64 get_start(u32 i) const;
+
+    //Samples between reads on a channel
+    u32 get_gap_len() const {return gap_len_;}
+
+    //Maximum samples used by a read and the following gap
+    u64 get_slot_len() const {return slot_len_;}
+
+    //Thread safe
+    ReadBuffer get_read(u32 i) const;
+
+    //Lists pseudo-file names covering up to FILE_READS reads each, so a
+    //Fast5Reader can split reads between its loader threads
+    std::vector<std::string> list_files() const;
+    static bool is_gen(const std::string &fname);
+    void file_reads(const std::string &fname, u32 &start, u32 &end) const;
+
+    #ifdef PYBIND
+
+    #define PY_SIGNAL_GEN_METH(N) c.def(#N, &SignalGen::N);
+    #define PY_SIGNAL_GEN_PRM(P) p.def_readwrite(#P, &SignalGen::Params::P);
+
+    static void pybind_defs(pybind11::class_<SignalGen> &c) {
+        c.def(pybind11::init<const Params &, const std::string &>(),
+              pybind11::arg("prms"), pybind11::arg("bwa_prefix")="");
+        PY_SIGNAL_GEN_METH(size);
+        PY_SIGNAL_GEN_METH(get_id);
+        PY_SIGNAL_GEN_METH(get_channel);
+        PY_SIGNAL_GEN_METH(get_number);
+        PY_SIGNAL_GEN_METH(get_start);
+        PY_SIGNAL_GEN_METH(get_read);
+
+        pybind11::class_<Params> p(c, "Params");
+        PY_SIGNAL_GEN_PRM(gen_reads);
+        PY_SIGNAL_GEN_PRM(gen_seed);
+        PY_SIGNAL_GEN_PRM(min_read_len);
+        PY_SIGNAL_GEN_PRM(max_read_len);
+        PY_SIGNAL_GEN_PRM(unmapped_frac);
+        PY_SIGNAL_GEN_PRM(dwell_shape);
+        PY_SIGNAL_GEN_PRM(stay_prob);
+        PY_SIGNAL_GEN_PRM(skip_prob);
+        PY_SIGNAL_GEN_PRM(level_noise);
+        PY_SIGNAL_GEN_PRM(sample_noise);
+        PY_SIGNAL_GEN_PRM(scale_stdv);
+        PY_SIGNAL_GEN_PRM(shift_stdv);
+        PY_SIGNAL_GEN_PRM(drift);
+        PY_SIGNAL_GEN_PRM(read_gap);
+    }
+
+    #endif
+
+    private:
+
+    //Calibration of the generated int16 samples, so reads can be stored
+    //in a SignalCache without loss
+    static const float CAL_DIGIT, CAL_RANGE, CAL_OFFSET;
+
+    class Rng;
+
+    //Reference source of a read. rid is negative for random sequence
+    typedef struct {
+        u32 len;
+        i32 rid;
+        u64 loc;
+        bool fwd;
+    } Segment;
+
+    Segment get_segment(Rng &rng) const;
+    std::string segment_id(u32 i, const Segment &s) const;
+
+    Params PRMS;
+
+    BwaIndex<KLEN> index_;
+    std::vector<std::string> ref_names_;
+    std::vector<u64> ref_offs_, ref_lens_, ref_ends_;
+
+    u16 num_channels_;
+    float mean_dwell_;
+    u32 gap_len_;
+    u64 max_samples_;
+    u64 slot_len_;
+};
+
+#endif
@@ -0,0 +1,412 @@
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <unistd.h>
+#include "conf.hpp"
+#include "client_sim.hpp"
+#include "signal_gen.hpp"
+#include "signal_cache.hpp"
+#include "model_r94.inl"
+
+//Consistency checks for simulated input
+//
+//  sim_test load [-n reads] [-c channels] [-M max_loaded_mb] [-o slow5]
+//      Writes a SLOW5 file of random reads, then simulates it in virtual
+//      time with reads loaded up front, and loaded lazily under the memory
+//      budget by 1 and 4 loader threads. Every configuration must emit
+//      the same chunks at the same times
+//
+//  sim_test gen [-n reads] [-c channels] [-o usig] bwa_prefix
+//      Checks SignalGen reads are deterministic, follow the pore model,
+//      and are the same through every Fast5Reader path, a SignalCache,
+//      and the simulator with eager and lazy loading
+//
+//Build with "make tsan" to also check the loader threads for races
+
+//Writes nreads reads of random signal, read i on channel (i % nchannels)+1
+void write_slow5(const std::string &fname, u32 nreads, u16 nchannels) {
+    std::ofstream out(fname);
+    out << "#slow5_version\t0.2.0\n"
+        << "#num_read_groups\t1\n"
+        << "@asic_id\tsim_test\n"
+        << "#char*\tuint32_t\tdouble\tdouble\tdouble\tdouble\tuint64_t\t"
+        << "int16_t*\tchar*\tdouble\tint32_t\tuint8_t\tuint64_t\n"
+        << "#read_id\tread_group\tdigitisation\toffset\trange\t"
+        << "sampling_rate\tlen_raw_signal\traw_signal\tchannel_number\t"
+        << "median_before\tread_number\tstart_mux\tstart_time\n";
+
+    //Raw engine output is the same with every standard library
+    std::mt19937 rng(1);
+
+    for (u32 i = 0; i < nreads; i++) {
+        u32 len = 10000 + rng() % 50000;
+        out << "sim" << i << "\t0\t8192\t10\t1400\t4000\t" << len << "\t";
+        for (u32 j = 0; j < len; j++) {
+            if (j > 0) out << ",";
+            out << 300 + rng() % 400;
+        }
+        out << "\t" << (i % nchannels + 1) << "\t250\t" << i
+            << "\t1\t" << (u64) i * 4000 << "\n";
+    }
+}
+
+//Simulates the reads in virtual time, and returns a line for each chunk
+//Reads come from gen if set, otherwise from fname
+//Unblocks some reads so the simulator skips ahead within a channel
+std::vector<std::string> simulate(const std::string &fname,
+                                  u32 nreads, u16 nchannels,
+                                  u32 max_loaded_mb, u16 load_threads,
+                                  const SignalGen *gen = NULL) {
+    Conf conf;
+    conf.set_num_channels(nchannels);
+    conf.set_virtual_time(true);
+    conf.set_max_loaded_mb(max_loaded_mb);
+    conf.set_load_threads(load_threads);
+
+    //Default is long enough to end a channel after one unblock
+    conf.set_ej_time(0.5);
+
+    ClientSim sim(conf);
+
+    if (gen != NULL) {
+        sim.add_generator(*gen);
+        nreads = 0;
+    }
+
+    //Each channel wraps around its reads a few times, and a read which
+    //was unloaded must be loaded again
+    for (u16 c = 1; c <= nchannels && nreads > 0; c++) {
+        sim.add_intv(c, 0, 0, 3000000 + c * 50000);
+        for (u32 i = c; i < nreads; i += nchannels) {
+            sim.add_gap(c, 0, i % 2 == 0 ? 500 : 900);
+        }
+    }
+
+    for (u32 i = 0; i < nreads; i++) {
+        sim.add_read(i % nchannels + 1, "sim" + std::to_string(i),
+                     (i % 3) * 500);
+    }
+
+    if (gen == NULL) sim.add_fast5(fname);
+    sim.load_fast5s();
+    sim.run();
+
+    std::vector<std::string> lines;
+    while (sim.is_running()) {
+        auto chunks = sim.get_read_chunks();
+        for (auto &p : chunks) {
+            Chunk &c = p.second;
+
+            double sum = 0;
+            for (float s : c.get_raw_data()) sum += s;
+
+            lines.push_back(
+                std::to_string((u64) (sim.get_runtime() * 4000 + 0.5)) + " " +
+                std::to_string(p.first) + " " + c.get_id() + " " +
+                std::to_string(c.get_number()) + " " +
+                std::to_string(c.get_start()) + " " +
+                std::to_string(c.size()) + " " + std::to_string(sum));
+
+            if (c.get_number() % 5 == 0 && c.get_start() % 3 == 0) {
+                sim.unblock_read(p.first, c.get_number());
+            }
+        }
+
+        if (chunks.empty()) sim.skip_to_next_event();
+    }
+
+    return lines;
+}
+
+//Compares chunk lines from two simulations, returns the number of errors
+u32 compare_chunks(const std::vector<std::string> &a, 
+                   const std::vector<std::string> &b) {
+    u32 diff = 0;
+    for (u32 i = 0; i < a.size() && i < b.size(); i++) {
+        if (a[i] != b[i] && diff++ == 0) {
+            std::cerr << "Error: chunk " << i << " differs\n"
+                      << "  eager: " << a[i] << "\n"
+                      << "  lazy:  " << b[i] << "\n";
+        }
+    }
+    return diff + (a.size() != b.size());
+}
+
+int run_load(int argc, char **argv) {
+    u32 nreads = 200, max_loaded_mb = 2;
+    u16 nchannels = 8;
+    std::string fname = "sim_test.slow5";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:c:M:o:")) != -1) {
+        switch (opt) {
+            case 'n':
+                nreads = atoi(optarg);
+                break;
+            case 'c':
+                nchannels = atoi(optarg);
+                break;
+            case 'M':
+                max_loaded_mb = atoi(optarg);
+                break;
+            case 'o':
+                fname = optarg;
+                break;
+            default:
+                std::cerr << "Error: unknown flag\n";
+                return 1;
+        }
+    }
+
+    std::cerr << "Writing " << nreads << " reads to " << fname << "\n";
+    write_slow5(fname, nreads, nchannels);
+
+    Timer t;
+    auto eager = simulate(fname, nreads, nchannels, 0, 1);
+    std::cout << "eager\t" << eager.size() << " chunks\t"
+              << t.lap() << " ms\n";
+
+    u32 errors = 0;
+    for (u16 threads : {1, 4}) {
+        auto lazy = simulate(fname, nreads, nchannels, max_loaded_mb, threads);
+        u32 diff = compare_chunks(eager, lazy);
+
+        std::cout << "lazy " << max_loaded_mb << "MB " << threads
+                  << " threads\t" << lazy.size() << " chunks\t"
+                  << t.lap() << " ms\t" << diff << " errors\n";
+        errors += diff;
+    }
+
+    return errors > 0;
+}
+
+bool same_read(const ReadBuffer &a, const ReadBuffer &b) {
+    return a.get_id() == b.get_id() && 
+           a.get_channel() == b.get_channel() &&
+           a.get_number() == b.get_number() &&
+           a.get_start() == b.get_start() &&
+           a.get_raw() == b.get_raw();
+}
+
+//Counts reads which differ from the generator, and reports the first
+u32 check_read(const SignalGen &gen, u32 i, const ReadBuffer &r, 
+               const std::string &source) {
+    if (same_read(gen.get_read(i), r)) return 0;
+    std::cerr << "Error: read " << i << " differs through " << source << "\n";
+    return 1;
+}
+
+//Matches a noise-free read to the template means of its reference k-mers
+//Every sample must be within tol of the current or a following k-mer's
+//mean. Reverse reads are checked backwards from the read's location
+u32 check_levels(const ReadBuffer &r, 
+                 BwaIndex<KLEN> &index, 
+                 const std::vector< std::pair<std::string, u64> > &seqs,
+                 u32 max_len, float tol) {
+
+    //IDs are gen<i>_<name or ref<rid>>_<loc><strand>
+    const std::string &id = r.get_id();
+    size_t a = id.find('_'), b = id.rfind('_');
+    std::string name = id.substr(a+1, b-a-1);
+    u64 loc = atoll(id.c_str() + b + 1);
+    bool fwd = id.back() == '+';
+
+    if (index.coord_to_pacseq(name, 0) == INT_MAX) {
+        name = seqs[atoi(name.c_str() + 3)].first;
+    }
+
+    u64 ref_len = 0;
+    for (auto &s : seqs) if (s.first == name) ref_len = s.second;
+
+    std::vector<u16> kmers = index.get_kmers(name, loc, 
+                                             std::min(loc + max_len, ref_len));
+
+    const std::vector<float> &raw = r.get_raw();
+    const PoreModel<KLEN> &model = pmodel_r94_template;
+
+    u32 k = 0;
+    for (u32 j = 0; j < raw.size(); j++) {
+        float samp = fwd ? raw[j] : raw[raw.size()-j-1];
+
+        for (; k < kmers.size(); k++) {
+            u16 kmer = fwd ? kmers[k] : kmer_revcomp<KLEN>(kmers[k]);
+            if (std::abs(samp - model.get_mean(kmer)) <= tol) break;
+        }
+
+        if (k == kmers.size()) {
+            std::cerr << "Error: sample " << j << " of " << id 
+                      << " doesn't match the model\n";
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int run_gen(int argc, char **argv) {
+    Conf conf;
+    u32 nreads = 2500;
+    u16 nchannels = 8;
+    std::string cache_fname = "sim_test.usig";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:c:o:")) != -1) {
+        switch (opt) {
+            case 'n':
+                nreads = atoi(optarg);
+                break;
+            case 'c':
+                nchannels = atoi(optarg);
+                break;
+            case 'o':
+                cache_fname = optarg;
+                break;
+            default:
+                std::cerr << "Error: unknown flag\n";
+                return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        std::cerr << "Error: must specify bwa_prefix\n";
+        return 1;
+    }
+    std::string prefix = argv[optind];
+
+    //Generator reads channel count from ReadBuffer::PRMS
+    conf.set_num_channels(nchannels);
+
+    SignalGen::Params prms = SignalGen::PRMS_DEF;
+    prms.gen_reads = nreads;
+    prms.min_read_len = 100;
+    prms.max_read_len = 4000;
+    prms.unmapped_frac = 0.2;
+
+    SignalGen gen(prms, prefix), gen2(prms, prefix);
+    u32 errors = 0, n;
+
+    //Reads depend only on their index
+    for (u32 i = 0; i < nreads; i += 7) {
+        ReadBuffer r = gen.get_read(i);
+        errors += check_read(gen, i, r, "get_read");
+        errors += check_read(gen2, i, r, "a second generator");
+        if (r.get_id() != gen.get_id(i) || 
+            r.get_channel() != gen.get_channel(i) ||
+            r.get_number() != gen.get_number(i) ||
+            r.get_start() != gen.get_start(i)) {
+            std::cerr << "Error: read " << i << " metadata differs\n";
+            errors++;
+        }
+    }
+    std::cout << "determinism\t" << errors << " errors\n";
+
+    //Without noise, stays or skips, samples follow the model exactly
+    //up to the int16 calibration
+    SignalGen::Params clean_prms = prms;
+    clean_prms.unmapped_frac = 0;
+    clean_prms.level_noise = clean_prms.sample_noise = 0;
+    clean_prms.scale_stdv = clean_prms.shift_stdv = 0;
+    clean_prms.stay_prob = clean_prms.skip_prob = 0;
+    clean_prms.drift = 0;
+    SignalGen clean(clean_prms, prefix);
+
+    BwaIndex<KLEN> index;
+    index.load_seqs(prefix);
+    auto seqs = index.get_seqs();
+
+    n = 0;
+    for (u32 i = 0; i < 100 && i < nreads; i++) {
+        n += check_levels(clean.get_read(i), index, seqs, 
+                          clean_prms.max_read_len, 0.5);
+    }
+    index.destroy();
+    std::cout << "levels\t" << n << " errors\n";
+    errors += n;
+
+    //Every Fast5Reader path gives the generator's reads
+    n = 0;
+    Fast5Reader popped;
+    popped.add_generator(gen);
+    for (u32 i = 0; i < nreads; i++) {
+        n += check_read(gen, i, popped.pop_read(), "pop_read");
+    }
+    n += !popped.empty();
+
+    Fast5Reader::Params fast5_prms = Fast5Reader::PRMS_DEF;
+    fast5_prms.load_threads = 4;
+    Fast5Reader threaded(fast5_prms);
+    threaded.add_generator(gen);
+    threaded.start_loading();
+
+    ReadBuffer r;
+    std::vector<bool> seen(nreads, false);
+    while (threaded.next_read(r)) {
+        u32 i = atoi(r.get_id().c_str() + 3);
+        n += seen[i];
+        seen[i] = true;
+        n += check_read(gen, i, r, "threaded loading");
+    }
+    n += std::count(seen.begin(), seen.end(), false);
+
+    Fast5Reader filtered;
+    filtered.add_read(gen.get_id(7));
+    filtered.add_read(gen.get_id(nreads-1));
+    filtered.add_generator(gen);
+    auto infos = filtered.list_reads();
+    n += infos.size() != 2;
+
+    Fast5Reader listed;
+    listed.copy_listed(filtered);
+    for (auto &info : infos) {
+        u32 i = atoi(info.id.c_str() + 3);
+        n += !listed.load_read(info, r) || check_read(gen, i, r, "list_reads");
+    }
+
+    std::cout << "fast5_reader\t" << n << " errors\n";
+    errors += n;
+
+    //Signal cache round trip
+    n = 0;
+    Fast5Reader cached;
+    cached.add_generator(gen);
+    n += SignalCache::build(cached, cache_fname) != nreads;
+
+    SignalCache cache;
+    if (cache.open(cache_fname)) {
+        for (u32 i = 0; i < nreads; i += 37) {
+            u32 c = cache.find(gen.get_id(i));
+            n += c >= cache.size() || 
+                 check_read(gen, i, cache.get_read(c), "the signal cache");
+        }
+    } else {
+        n++;
+    }
+
+    std::cout << "signal_cache\t" << n << " errors\n";
+    errors += n;
+
+    //Simulator output is the same however reads are loaded
+    SignalGen::Params sim_prms = prms;
+    sim_prms.gen_reads = std::min(nreads, 200u);
+    SignalGen sim_gen(sim_prms, prefix);
+
+    auto eager = simulate("", 0, nchannels, 0, 1, &sim_gen),
+         lazy = simulate("", 0, nchannels, 1, 4, &sim_gen);
+    n = compare_chunks(eager, lazy) + eager.empty();
+
+    std::cout << "simulator\t" << eager.size() << " chunks\t" 
+              << n << " errors\n";
+    errors += n;
+
+    return errors > 0;
+}
+
+int main(int argc, char **argv) {
+    std::string mode = argc > 1 ? argv[1] : "";
+
+    if (mode == "load") return run_load(argc-1, argv+1);
+    if (mode == "gen") return run_gen(argc-1, argv+1);
+
+    std::cerr << "Usage: sim_test load|gen [options]\n";
+    return 1;
+}
@@ -0,0 +1,282 @@
+/* MIT License
+ *
+ * Copyright (c) 2018 Sam Kovaka <skovaka@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+#include "slow5_file.hpp"
+
+std::deque< std::pair<std::string, Slow5File::IndexPtr> > 
+    Slow5File::index_cache_;
+std::mutex Slow5File::cache_mtx_;
+
+Slow5File::Index::Index() 
+    : id_col(-1), 
+      digit_col(-1), 
+      offset_col(-1), 
+      range_col(-1), 
+      signal_col(-1),
+      channel_col(-1), 
+      number_col(-1), 
+      start_col(-1), 
+      ncols(0) {}
+
+Slow5File::Slow5File() {}
+
+static bool ends_with(const std::string &s, const std::string &suffix) {
+    return s.size() >= suffix.size() && 
+           s.compare(s.size()-suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool Slow5File::is_slow5(const std::string &fname) {
+    return ends_with(fname, ".slow5");
+}
+
+bool Slow5File::is_blow5(const std::string &fname) {
+    return ends_with(fname, ".blow5");
+}
+
+//Finds required columns in the "#read_id" header line
+bool Slow5File::Index::parse_columns(const std::string &line) {
+    std::vector<std::string> names;
+    size_t st = 1, en;
+    do {
+        en = line.find('\t', st);
+        names.push_back(line.substr(st, en == std::string::npos ? en : en-st));
+        st = en+1;
+    } while (en != std::string::npos);
+
+    ncols = names.size();
+    for (u32 i = 0; i < ncols; i++) {
+        const std::string &n = names[i];
+        if (n == "read_id") id_col = i;
+        else if (n == "digitisation") digit_col = i;
+        else if (n == "offset") offset_col = i;
+        else if (n == "range") range_col = i;
+        else if (n == "raw_signal") signal_col = i;
+        else if (n == "channel_number") channel_col = i;
+        else if (n == "read_number") number_col = i;
+        else if (n == "start_time") start_col = i;
+    }
+
+    return id_col >= 0 && digit_col >= 0 && offset_col >= 0 && 
+           range_col >= 0 && signal_col >= 0;
+}
+
+bool Slow5File::Index::find(const std::string &read_id, u64 &offset) const {
+    auto i = std::lower_bound(id_order.begin(), id_order.end(), read_id,
+                              [this](u32 a, const std::string &id) {
+                                  return read_ids[a] < id;
+                              });
+    if (i == id_order.end() || read_ids[*i] != read_id) return false;
+
+    offset = offsets[*i];
+    return true;
+}
+
+//Scans the whole file for the header and record offsets
+//Returns NULL if the header can't be parsed
+Slow5File::IndexPtr Slow5File::build_index(std::ifstream &file, 
+                                           const std::string &fname) {
+    std::shared_ptr<Index> idx(new Index());
+
+    std::string line;
+    bool has_cols = false;
+    u64 offs = file.tellg();
+
+    while (getline(file, line)) {
+        if (line.empty()) {
+            offs = file.tellg();
+            continue;
+        }
+
+        if (line[0] == '@' || line[0] == '#') {
+            if (line.compare(0, 8, "#read_id") == 0) {
+                has_cols = idx->parse_columns(line);
+            }
+
+        } else {
+            idx->read_ids.push_back(line.substr(0, line.find('\t')));
+            idx->offsets.push_back(offs);
+        }
+        offs = file.tellg();
+    }
+
+    file.clear();
+
+    const std::vector<std::string> &ids = idx->read_ids;
+    idx->id_order.resize(ids.size());
+    for (u32 i = 0; i < ids.size(); i++) {
+        idx->id_order[i] = i;
+    }
+    std::sort(idx->id_order.begin(), idx->id_order.end(),
+              [&ids](u32 a, u32 b) { return ids[a] < ids[b]; });
+
+    if (!has_cols || idx->id_col != 0) {
+        std::cerr << "Error: failed to parse slow5 header of \"" 
+                  << fname << "\"\n";
+        return IndexPtr();
+    }
+
+    return idx;
+}
+
+Slow5File::IndexPtr Slow5File::find_cached(const std::string &fname) {
+    for (auto c = index_cache_.begin(); c != index_cache_.end(); c++) {
+        if (c->first == fname) {
+            IndexPtr idx = c->second;
+
+            //Most recently used at the back
+            index_cache_.erase(c);
+            index_cache_.emplace_back(fname, idx);
+            return idx;
+        }
+    }
+    return IndexPtr();
+}
+
+bool Slow5File::open(const std::string &fname) {
+    if (is_open()) close();
+
+    if (is_blow5(fname)) {
+        std::cerr << "Error: BLOW5 is not supported, convert \"" << fname 
+                  << "\" to SLOW5 with \"slow5tools view --to slow5\"\n";
+        return false;
+    }
+
+    file_.open(fname);
+    if (!file_.is_open()) {
+        std::cerr << "Error: failed to open slow5 \"" << fname << "\"\n";
+        return false;
+    }
+    fname_ = fname;
+
+    std::unique_lock<std::mutex> lck(cache_mtx_);
+    idx_ = find_cached(fname);
+    if (idx_) return true;
+    lck.unlock();
+
+    //Other threads may index different files at the same time
+    idx_ = build_index(file_, fname);
+    if (!idx_) {
+        close();
+        return false;
+    }
+
+    //Another thread may have indexed the same file meanwhile
+    lck.lock();
+    IndexPtr cached = find_cached(fname);
+    if (cached) {
+        idx_ = cached;
+        return true;
+    }
+
+    index_cache_.emplace_back(fname, idx_);
+    if (index_cache_.size() > MAX_CACHED_INDEXES) {
+        index_cache_.pop_front();
+    }
+
+    return true;
+}
+
+bool Slow5File::is_open() const {
+    return file_.is_open();
+}
+
+void Slow5File::close() {
+    if (file_.is_open()) file_.close();
+    fname_.clear();
+    idx_.reset();
+}
+
+//Reads the record line of a read and finds the start of each column
+bool Slow5File::read_record(const std::string &read_id, std::string &line, 
+                            std::vector<const char *> &cols) {
+    u64 offs;
+    if (!idx_->find(read_id, offs)) {
+        std::cerr << "Error: read \"" << read_id << "\" not in \""
+                  << fname_ << "\"\n";
+        return false;
+    }
+
+    file_.seekg(offs);
+    getline(file_, line);
+
+    cols.assign(idx_->ncols, NULL);
+    size_t st = 0;
+    for (u32 i = 0; i < idx_->ncols && st != std::string::npos; i++) {
+        cols[i] = line.c_str() + st;
+        st = line.find('\t', st);
+        if (st != std::string::npos) st++;
+    }
+
+    if (cols[idx_->signal_col] == NULL) {
+        std::cerr << "Error: failed to parse slow5 record \"" 
+                  << read_id << "\"\n";
+        return false;
+    }
+
+    return true;
+}
+
+u64 Slow5File::col_int(const std::vector<const char *> &cols, i32 c) {
+    if (c < 0 || cols[c] == NULL) return 0;
+    return strtoull(cols[c], NULL, 10);
+}
+
+bool Slow5File::read_meta(const std::string &read_id, 
+                          u16 &channel, u64 &start_sample) {
+    std::string line;
+    std::vector<const char *> cols;
+    if (!read_record(read_id, line, cols)) return false;
+
+    channel = col_int(cols, idx_->channel_col);
+    start_sample = col_int(cols, idx_->start_col);
+    return true;
+}
+
+bool Slow5File::read(const std::string &read_id, ReadBuffer &read) {
+    std::string line;
+    std::vector<const char *> cols;
+    if (!read_record(read_id, line, cols)) return false;
+
+    std::vector<i16> int_data;
+    const char *s = cols[idx_->signal_col];
+    char *end;
+    while (true) {
+        int_data.push_back(strtol(s, &end, 10));
+        if (*end != ',') break;
+        s = end+1;
+    }
+
+    read = ReadBuffer(read_id,
+                      col_int(cols, idx_->channel_col),
+                      col_int(cols, idx_->number_col),
+                      col_int(cols, idx_->start_col),
+                      int_data,
+                      atof(cols[idx_->digit_col]),
+                      atof(cols[idx_->range_col]),
+                      atof(cols[idx_->offset_col]));
+
+    return true;
+}
@@ -0,0 +1,104 @@
+/* MIT License
+ *
+ * Copyright (c) 2018 Sam Kovaka <skovaka@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _INCL_SLOW5_FILE
+#define _INCL_SLOW5_FILE
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include "read_buffer.hpp"
+#include "util.hpp"
+
+//Reads the ASCII SLOW5 format. Record offsets are indexed the first time a
+//file is opened, so reads can be loaded in any order without HDF5
+class Slow5File {
+    public:
+
+    Slow5File();
+
+    bool open(const std::string &fname);
+    bool is_open() const;
+    void close();
+
+    //IDs of all reads in file order
+    const std::vector<std::string> &get_read_ids() const {return idx_->read_ids;}
+
+    bool read(const std::string &read_id, ReadBuffer &read);
+
+    //Parses a record without its signal
+    bool read_meta(const std::string &read_id, u16 &channel, u64 &start_sample);
+
+    static bool is_slow5(const std::string &fname);
+    static bool is_blow5(const std::string &fname);
+
+    private:
+
+    //Parsed header and record offsets of one file
+    struct Index {
+        //Read IDs and record offsets in file order
+        std::vector<std::string> read_ids;
+        std::vector<u64> offsets;
+
+        //Positions in read_ids sorted by ID, so each ID is only stored once
+        std::vector<u32> id_order;
+
+        //Column indices, -1 if missing
+        i32 id_col, digit_col, offset_col, range_col, signal_col,
+            channel_col, number_col, start_col;
+        u32 ncols;
+
+        Index();
+        bool parse_columns(const std::string &line);
+
+        //Returns false if the read isn't in the file
+        bool find(const std::string &read_id, u64 &offset) const;
+    };
+
+    typedef std::shared_ptr<const Index> IndexPtr;
+
+    static IndexPtr build_index(std::ifstream &file, const std::string &fname);
+
+    //Must hold cache_mtx_. Returns NULL if the file isn't cached
+    static IndexPtr find_cached(const std::string &fname);
+
+    bool read_record(const std::string &read_id, std::string &line, 
+                     std::vector<const char *> &cols);
+    static u64 col_int(const std::vector<const char *> &cols, i32 c);
+
+    std::ifstream file_;
+    std::string fname_;
+    IndexPtr idx_;
+
+    //Indexes of the most recently opened files, so files reopened by
+    //Fast5Reader::load_read are not rescanned. Open files keep their
+    //index after it leaves the cache
+    static const u32 MAX_CACHED_INDEXES = 16;
+    static std::deque< std::pair<std::string, IndexPtr> > index_cache_;
+    static std::mutex cache_mtx_;
+};
+
+#endif
@@ -0,0 +1,134 @@
+/* MIT License
+ *
+ * Copyright (c) 2018 Sam Kovaka <skovaka@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _INCL_SPSC_QUEUE
+#define _INCL_SPSC_QUEUE
+
+#include <vector>
+#include <atomic>
+#include "util.hpp"
+
+//Bounded lock-free queue for passing values from exactly one producer thread
+//to exactly one consumer thread. Capacity is rounded up to a power of two.
+//resize() is not thread safe and must be called before the queue is shared
+template <typename T>
+class SpscQueue {
+    public:
+
+    SpscQueue(u32 capacity = 0) : mask_(0), head_(0), tail_(0) {
+        resize(capacity);
+    }
+
+    SpscQueue(const SpscQueue &q) : SpscQueue(q.capacity()) {}
+
+    void resize(u32 capacity) {
+        u32 len = 1;
+        while (len < capacity) len <<= 1;
+        buffer_.resize(len);
+        mask_ = len - 1;
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+    }
+
+    u32 capacity() const {
+        return buffer_.size();
+    }
+
+    //Producer only
+    bool push(const T &v) {
+        u32 tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) >= buffer_.size()) {
+            return false;
+        }
+        buffer_[tail & mask_] = v;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    //Producer only, pushes as many of the n values as there is room for
+    //Returns the number pushed
+    u32 push(const T *vals, u32 n) {
+        u32 tail = tail_.load(std::memory_order_relaxed),
+            room = buffer_.size() - (tail - head_.load(std::memory_order_acquire));
+        if (n > room) n = room;
+        for (u32 i = 0; i < n; i++) {
+            buffer_[(tail + i) & mask_] = vals[i];
+        }
+        tail_.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    //Consumer only
+    bool pop(T &v) {
+        u32 head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        v = buffer_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    //Consumer only, appends everything pushed so far to out
+    u32 pop_all(std::vector<T> &out) {
+        u32 head = head_.load(std::memory_order_relaxed),
+            n = tail_.load(std::memory_order_acquire) - head;
+        out.reserve(out.size() + n);
+        for (u32 i = 0; i < n; i++) {
+            out.push_back(buffer_[(head + i) & mask_]);
+        }
+        head_.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    //Consumer only, discards everything pushed so far
+    void clear() {
+        head_.store(tail_.load(std::memory_order_acquire), 
+                    std::memory_order_release);
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == 
+               tail_.load(std::memory_order_acquire);
+    }
+
+    bool full() const {
+        return size() >= buffer_.size();
+    }
+
+    u32 size() const {
+        u32 head = head_.load(std::memory_order_acquire);
+        return tail_.load(std::memory_order_acquire) - head;
+    }
+
+    private:
+    std::vector<T> buffer_;
+    u32 mask_;
+
+    //Pad indices onto separate cache lines to avoid false sharing
+    std::atomic<u32> head_;
+    char pad_[64 - sizeof(std::atomic<u32>)];
+    std::atomic<u32> tail_;
+};
+
+#endif
@@ -31,26 +31,50 @@ typedef struct {
     enum class Mode {DEPLETE, ENRICH, NUM};
     Mode realtime_mode;
 
+    //Number of flow cells served by one pool, each with num_channels
+    //channels. Devices can override realtime_mode with device_modes
+    u16 num_devices;
+    std::vector<Mode> device_modes;
+
     std::string host;
     u16 port;
     float duration;
 
     u32 max_active_reads;
+    u16 signal_threads;
+
+    //Order in which mapper threads service their channels
+    enum class Schedule {ROUND_ROBIN, DEADLINE, NUM};
+    Schedule schedule;
+
+    //Give up on the lowest value reads when chunks have waited this long
+    float shed_age;
 } RealtimeParams;
 
 const RealtimeParams REALTIME_PRMS_DEF = {
     active_chs       : RealtimeParams::ActiveChs::FULL,
     realtime_mode    : RealtimeParams::Mode::ENRICH,
+    num_devices      : 1,
+    device_modes     : {},
     host             : "127.0.0.1",
     port             : 8000,
     duration         : 72,
-    max_active_reads : 512
+    max_active_reads : 512,
+    signal_threads   : 0,
+    schedule         : RealtimeParams::Schedule::ROUND_ROBIN,
+    shed_age         : 0
 };
 
 typedef struct {
     std::string ctl_seqsum, unc_seqsum, unc_paf;
     float sim_speed, scan_time, scan_intv_time, ej_time;
     u32 min_ch_reads;
+
+    //Steps a virtual clock from event to event instead of waiting in
+    //real time. Measured mapping time is charged to the clock, scaled by
+    //compute_scale (0 makes runs independent of host speed)
+    bool virtual_time;
+    float compute_scale;
 } SimParams;
 
 const SimParams SIM_PRMS_DEF = {
@@ -61,15 +85,19 @@ const SimParams SIM_PRMS_DEF = {
     scan_time      : 10,
     scan_intv_time : 10.0,
     ej_time        : 5400.0,
-    min_ch_reads   : 0 //TODO is this needed?
+    min_ch_reads   : 0, //TODO is this needed?
+    virtual_time   : false,
+    compute_scale  : 1.0
 };
 
 typedef struct {
     u32 min_active_reads;
+    u32 max_loaded_mb; //0 loads all reads before mapping
 } MapOrdParams;
 
 const MapOrdParams MAP_ORD_PRMS_DEF = {
-    min_active_reads : 0
+    min_active_reads : 0,
+    max_loaded_mb    : 0
 };
 
 #endif
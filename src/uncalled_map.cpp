@@ -1,7 +1,9 @@
 #include <iostream>
 #include <cstdlib>
 #include <unistd.h>
+#include <memory>
 #include "map_pool.hpp"
+#include "paf_writer.hpp"
 
 bool load_conf(int argc, char** argv, Conf &conf);
 
@@ -14,25 +16,36 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    //Synthetic reads are generated from the index reference
+    std::unique_ptr<SignalGen> gen;
+    if (conf.get_gen_reads() > 0) {
+        gen.reset(new SignalGen(conf.gen_prms, conf.get_bwa_prefix()));
+    }
+
     MapPool pool(conf);
+    if (gen) pool.add_generator(*gen);
 
     u64 MAX_SLEEP = 100;
 
     std::cerr << "Mapping\n";
 
+    PafWriter paf_out(std::cout, conf.get_paf_format());
+
     Timer t;
 
     while (pool.running()) {
         u64 t0 = t.get();
-        for (Paf p : pool.update()) {
-            p.print_paf();
+        for (Paf &p : pool.update()) {
+            paf_out.write(std::move(p));
         }
         u64 dt = t.get() - t0;
-        if (dt < MAX_SLEEP) usleep(1000*(MAX_SLEEP - dt));
+        if (dt < MAX_SLEEP) pool.wait_results(MAX_SLEEP - dt);
     }
 
     std::cerr << "Finishing\n";
 
+    paf_out.close();
+
     pool.stop();
 
 }
@@ -55,7 +68,7 @@ int main(int argc, char** argv) {
 
 bool load_conf(int argc, char** argv, Conf &conf) {
     int opt;
-    std::string flagstr = ":t:n:l:";
+    std::string flagstr = ":t:n:l:g:b";
 
     #ifdef DEBUG_OUT
     flagstr += "D:";
@@ -68,11 +81,16 @@ bool load_conf(int argc, char** argv, Conf &conf) {
             FLAG_TO_CONF('t', atoi, threads)
             FLAG_TO_CONF('n', atoi, max_reads)
             FLAG_TO_CONF('l', std::string, read_list)
+            FLAG_TO_CONF('g', atoi, gen_reads)
 
             #ifdef DEBUG_OUT
             FLAG_TO_CONF('D', std::string, dbg_prefix);
             #endif
 
+            case 'b':
+            conf.set_binary_paf(true);
+            break;
+
             case ':':  
             std::cerr << "Error: failed to load flag value\n";  
             return false;
@@ -88,7 +106,11 @@ bool load_conf(int argc, char** argv, Conf &conf) {
     int i = optind;
 
     POSITIONAL_TO_CONF(std::string, bwa_prefix)
-    POSITIONAL_TO_CONF(std::string, fast5_list)
+
+    //The fast5 list is optional if synthetic reads are mapped
+    if (conf.get_gen_reads() == 0 || i < argc) {
+        POSITIONAL_TO_CONF(std::string, fast5_list)
+    }
 
     return true;
 }
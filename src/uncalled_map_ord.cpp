@@ -2,6 +2,7 @@
 #include <cstdlib>
 #include <unistd.h>
 #include "map_pool_ord.hpp"
+#include "paf_writer.hpp"
 
 void load_conf(int argc, char** argv, Conf &conf);
 
@@ -24,11 +25,13 @@ int main(int argc, char** argv) {
 
     std::cerr << "Mapping\n";
 
+    PafWriter paf_out(std::cout, conf.get_paf_format());
+
 
     while (pool.running()) {
         u64 t0 = t.get();
-        for (Paf p : pool.update()) {
-            p.print_paf();
+        for (Paf &p : pool.update()) {
+            paf_out.write(std::move(p));
         }
         u64 dt = t.get() - t0;
         if (dt < MAX_SLEEP) usleep(1000*(MAX_SLEEP - dt));
@@ -38,6 +41,8 @@ int main(int argc, char** argv) {
 
     std::cerr << "Finishing\n";
 
+    paf_out.close();
+
     pool.stop();
 
 }
@@ -60,7 +65,7 @@ int main(int argc, char** argv) {
 
 void load_conf(int argc, char** argv, Conf &conf) {
     int opt;
-    std::string flagstr = "C:t:n:r:R:c:l:s:w:";
+    std::string flagstr = "C:t:n:r:R:c:l:s:w:M:x:b";
 
     #ifdef DEBUG_OUT
     flagstr += "D:";
@@ -78,10 +83,16 @@ void load_conf(int argc, char** argv, Conf &conf) {
             FLAG_TO_CONF('l', std::string, read_list)
             FLAG_TO_CONF('s', atof, win_stdv_min)
             FLAG_TO_CONF('w', atof, win_len)
+            FLAG_TO_CONF('M', atoi, max_loaded_mb)
+            FLAG_TO_CONF('x', std::string, fast5_index)
             #ifdef DEBUG_OUT
             FLAG_TO_CONF('D', std::string, dbg_prefix);
             #endif
 
+            case 'b':
+            conf.set_binary_paf(true);
+            break;
+
             case 'C':
             std::cerr << "Conf: " << optarg << "\n";
             conf.load_toml(std::string(optarg));
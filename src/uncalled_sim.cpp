@@ -1,5 +1,6 @@
 #include <iostream>
 #include <unistd.h>
+#include <memory>
 #include "conf.hpp"
 #include "client_sim.hpp"
 #include "realtime_pool.hpp"
@@ -20,8 +21,18 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    //Must outlive the simulator, which loads reads in the background
+    std::unique_ptr<SignalGen> gen;
+
     ClientSim sim(conf);
 
+    if (conf.get_gen_reads() > 0) {
+        std::cerr << "Generating " << conf.get_gen_reads() << " reads\n";
+        gen.reset(new SignalGen(conf.gen_prms, conf.get_bwa_prefix()));
+        sim.add_generator(*gen);
+        sim.load_fast5s();
+    }
+
     std::cerr << "Loading mappers\n";
     RealtimePool pool(conf);
 
@@ -35,18 +46,35 @@ int main(int argc, char** argv) {
     std::vector<u32> unblocked(conf.get_num_channels(), 0);
 
     bool deplete = conf.get_realtime_mode() == RealtimeParams::Mode::DEPLETE;
+    bool vtime = conf.get_virtual_time();
+
+    //Times mapping between virtual time steps
+    Timer step;
 
     std::cerr << "Starting " << deplete << "\n";
 
+    PafWriter &paf_out = pool.get_paf_writer();
+
     while (sim.is_running()) {
         u64 t0 = t.get();
 
         u16 channel;
         u32 number;
         Paf paf;
-        for (MapResult m : pool.update()) {
+
+        std::vector<MapResult> results;
+        if (vtime) {
+            results = pool.update_mapped();
+            sim.advance(step.get());
+        } else {
+            results = pool.update();
+        }
+
+        float now = vtime ? sim.get_runtime() * 1000 : t.get();
+
+        for (MapResult &m : results) {
             std::tie(channel, number, paf) = m;
-            float map_time = (t.get() - chunk_times[channel-1])/1000;
+            float map_time = (now - chunk_times[channel-1])/1000;
 
             if (paf.is_ended()) {
                 paf.set_float(Paf::Tag::ENDED, map_time);
@@ -64,26 +92,32 @@ int main(int argc, char** argv) {
                 sim.stop_receiving_read(channel, number);
                 paf.set_float(Paf::Tag::KEEP, map_time);
             }
-            paf.print_paf();
-            std::cout.flush();
+            paf_out.write(std::move(paf));
         }
 
-        for (auto &r : sim.get_read_chunks()) {
+        auto chunks = sim.get_read_chunks();
+        for (auto &r : chunks) {
             Chunk &ch = r.second;
             if (unblocked[ch.get_channel_idx()] == ch.get_number()) {
-                std::cout << "# recieved chunk from " 
-                          << ch.get_id() 
-                          << " after unblocking\n";
+                paf_out.write_comment(" recieved chunk from " 
+                                      + ch.get_id() 
+                                      + " after unblocking");
                 continue;
             } else if (pool.add_chunk(ch)) {
-                chunk_times[ch.get_channel_idx()] = t.get();
+                chunk_times[ch.get_channel_idx()] = now;
             } else {
                 std::cerr << "Error: failed to add chunk from " << ch.get_id() << std::endl;
             }
         }
 
+        if (vtime) {
+            if (results.empty() && chunks.empty()) sim.skip_to_next_event();
+            step.reset();
+            continue;
+        }
+
         u64 dt = t.get() - t0;
-        if (dt < MAX_SLEEP) usleep(1000*(MAX_SLEEP - dt));
+        if (dt < MAX_SLEEP) pool.wait_results(MAX_SLEEP - dt);
     }
     std::cerr << "Reads aligned (" << (t.get() / 1000) << " sec)\n";
 
@@ -109,7 +143,7 @@ int main(int argc, char** argv) {
 
 bool load_conf(int argc, char** argv, Conf &conf) {
     int opt;
-    std::string flagstr = ":t:c:p:de";
+    std::string flagstr = ":t:s:c:p:M:L:g:debv";
 
     #ifdef DEBUG_OUT
     flagstr += "D:";
@@ -121,7 +155,11 @@ bool load_conf(int argc, char** argv, Conf &conf) {
 
             FLAG_TO_CONF('p', std::string, idx_preset)
             FLAG_TO_CONF('t', atoi, threads)
+            FLAG_TO_CONF('s', atoi, signal_threads)
             FLAG_TO_CONF('c', atoi, max_chunks)
+            FLAG_TO_CONF('M', atoi, max_loaded_mb)
+            FLAG_TO_CONF('L', atoi, load_threads)
+            FLAG_TO_CONF('g', atoi, gen_reads)
 
             #ifdef DEBUG_OUT
             FLAG_TO_CONF('D', std::string, dbg_prefix);
@@ -135,6 +173,14 @@ bool load_conf(int argc, char** argv, Conf &conf) {
                 conf.set_realtime_mode(RealtimeParams::Mode::ENRICH);
                 break;
 
+            case 'b':
+                conf.set_binary_paf(true);
+                break;
+
+            case 'v':
+                conf.set_virtual_time(true);
+                break;
+
             case ':':  
             std::cerr << "Error: failed to load flag value\n";  
             return false;
@@ -150,7 +196,11 @@ bool load_conf(int argc, char** argv, Conf &conf) {
     int i = optind;
 
     POSITIONAL_TO_CONF(std::string, bwa_prefix)
-    POSITIONAL_TO_CONF(std::string, fast5_list)
+
+    //The fast5 list is optional if synthetic reads are simulated
+    if (conf.get_gen_reads() == 0 || i < argc) {
+        POSITIONAL_TO_CONF(std::string, fast5_list)
+    }
 
     return true;
 }
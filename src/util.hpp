@@ -29,6 +29,8 @@
 #include <cstdint>
 #include <chrono>
 #include <cassert>
+#include <mutex>
+#include <condition_variable>
 
 #ifdef PYBIND
 #include "pybind11/pybind11.h"
@@ -76,4 +78,34 @@ class Timer {
         }
 };
 
+//Lets a controller thread sleep until worker threads have output ready,
+//rather than polling at a fixed interval
+class Notifier {
+    private:
+        std::mutex mtx_;
+        std::condition_variable cv_;
+        bool ready_;
+
+    public:
+        inline Notifier() : ready_(false) {}
+
+        inline void notify() {
+            mtx_.lock();
+            ready_ = true;
+            mtx_.unlock();
+            cv_.notify_one();
+        }
+
+        //Waits up to max_ms milliseconds, returns true if notified
+        inline bool wait(float max_ms) {
+            std::unique_lock<std::mutex> lock(mtx_);
+            cv_.wait_for(lock, 
+                         std::chrono::microseconds((u64) (max_ms * 1000)), 
+                         [this] {return ready_;});
+            bool ret = ready_;
+            ready_ = false;
+            return ret;
+        }
+};
+
 #endif
@@ -0,0 +1,237 @@
+/* MIT License
+ *
+ * Copyright (c) 2018 Sam Kovaka <skovaka@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstring>
+#include <algorithm>
+#include "vbz.hpp"
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+
+//Shuffle masks which expand four 1-4 byte values into 32-bit lanes,
+//and the number of data bytes used, for each StreamVByte key byte
+static const struct SvbShuffles {
+    u8 masks[256][16];
+    u8 lens[256];
+
+    SvbShuffles() {
+        for (u32 key = 0; key < 256; key++) {
+            u8 b = 0;
+            for (u8 j = 0; j < 4; j++) {
+                u8 len = ((key >> (2*j)) & 3) + 1;
+                for (u8 k = 0; k < 4; k++) {
+                    masks[key][4*j+k] = k < len ? b+k : 0x80;
+                }
+                b += len;
+            }
+            lens[key] = b;
+        }
+    }
+} SVB_SHUFFLES;
+#endif
+
+bool Vbz::read_signal(hid_t file_id, 
+                      const std::string &path, 
+                      std::vector<i16> &signal) {
+
+    hid_t dset = H5Dopen2(file_id, path.c_str(), H5P_DEFAULT);
+    if (dset < 0) return false;
+
+    hid_t dcpl = H5Dget_create_plist(dset),
+          space = H5Dget_space(dset);
+
+    u32 opts[4] = {0, 0, 0, 0};
+    unsigned flags;
+    size_t nopts = 4;
+    hsize_t len = 0, chunk_len = 0, nchunks = 0;
+
+    bool native = 
+        H5Pget_layout(dcpl) == H5D_CHUNKED &&
+        H5Pget_nfilters(dcpl) == 1 &&
+        H5Pget_filter_by_id2(dcpl, FILTER_ID, &flags, &nopts, opts, 
+                             0, NULL, NULL) >= 0 &&
+        H5Sget_simple_extent_ndims(space) == 1 &&
+        H5Sget_simple_extent_dims(space, &len, NULL) == 1 &&
+        H5Pget_chunk(dcpl, 1, &chunk_len) == 1 &&
+        H5Dget_num_chunks(dset, H5S_ALL, &nchunks) >= 0;
+
+    //Compressed bytes of each chunk, keyed by first sample
+    std::vector< std::pair< hsize_t, std::vector<u8> > > chunks;
+
+    if (native) chunks.resize(nchunks);
+
+    for (hsize_t i = 0; native && i < nchunks; i++) {
+        unsigned mask;
+        haddr_t addr;
+        hsize_t size;
+
+        native = H5Dget_chunk_info(dset, H5S_ALL, i, &chunks[i].first, 
+                                   &mask, &addr, &size) >= 0;
+        if (!native) break;
+
+        //Unfiltered chunks have a nonzero mask
+        chunks[i].second.resize(size);
+        native = H5Dread_chunk(dset, H5P_DEFAULT, &chunks[i].first, 
+                               &mask, chunks[i].second.data()) >= 0 &&
+                 mask == 0;
+    }
+
+    H5Sclose(space);
+    H5Pclose(dcpl);
+    H5Dclose(dset);
+
+    if (!native) return false;
+
+    signal.resize(len);
+    for (auto &c : chunks) {
+        if (c.first >= len) continue;
+
+        size_t n = std::min(chunk_len, len - c.first);
+        if (!decode_chunk(c.second.data(), c.second.size(), 
+                          opts, &signal[c.first], n)) {
+            signal.clear();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Vbz::decode_chunk(const u8 *in, size_t in_len, 
+                       const u32 opts[4], 
+                       i16 *out, size_t n) {
+
+    if (opts[INT_SIZE] != sizeof(i16) || in_len < sizeof(u32)) return false;
+
+    //Chunks start with the size of the unfiltered data
+    u32 orig_size;
+    memcpy(&orig_size, in, sizeof(u32));
+    in += sizeof(u32);
+    in_len -= sizeof(u32);
+
+    size_t count = std::min(orig_size / sizeof(i16), n);
+
+    std::vector<u8> zstd_out;
+    if (opts[ZSTD_LEVEL] != 0) {
+        #ifdef HAVE_ZSTD
+        unsigned long long size = ZSTD_getFrameContentSize(in, in_len);
+        if (size == ZSTD_CONTENTSIZE_ERROR || 
+            size == ZSTD_CONTENTSIZE_UNKNOWN) {
+            return false;
+        }
+
+        zstd_out.resize(size);
+        size_t ret = ZSTD_decompress(zstd_out.data(), size, in, in_len);
+        if (ZSTD_isError(ret)) return false;
+
+        in = zstd_out.data();
+        in_len = ret;
+        #else
+        return false;
+        #endif
+    }
+
+    std::vector<u32> vals(count);
+    size_t decoded;
+    if (opts[VERSION] == 0) {
+        decoded = svb_decode(in, in_len, vals.data(), count);
+    } else {
+        decoded = svb_decode_half(in, in_len, vals.data(), count);
+    }
+
+    if (decoded != count) return false;
+
+    if (!opts[ZIGZAG]) {
+        for (size_t i = 0; i < count; i++) {
+            out[i] = (i16) vals[i];
+        }
+        return true;
+    }
+
+    i16 prev = 0;
+    for (size_t i = 0; i < count; i++) {
+        u32 v = vals[i];
+        prev = (i16) (prev + (i16) ((v >> 1) ^ -(i32) (v & 1)));
+        out[i] = prev;
+    }
+
+    return true;
+}
+
+size_t Vbz::svb_decode(const u8 *in, size_t in_len, u32 *out, size_t n) {
+    size_t keys_len = (n + 3) / 4;
+    if (keys_len > in_len) return 0;
+
+    const u8 *keys = in, 
+             *data = in + keys_len, 
+             *end = in + in_len;
+    size_t i = 0;
+
+    #ifdef __SSSE3__
+    //Four values per key while a full 16 bytes can be loaded
+    for (; i+4 <= n && end - data >= 16; i += 4) {
+        u8 key = keys[i/4];
+        __m128i v = _mm_loadu_si128((const __m128i *) data),
+                m = _mm_loadu_si128((const __m128i *) SVB_SHUFFLES.masks[key]);
+        _mm_storeu_si128((__m128i *) (out + i), _mm_shuffle_epi8(v, m));
+        data += SVB_SHUFFLES.lens[key];
+    }
+    #endif
+
+    for (; i < n; i++) {
+        u8 len = ((keys[i/4] >> (2*(i%4))) & 3) + 1;
+        if (end - data < len) return i;
+
+        u32 v = 0;
+        for (u8 b = 0; b < len; b++) {
+            v |= ((u32) data[b]) << (8*b);
+        }
+        out[i] = v;
+        data += len;
+    }
+
+    return n;
+}
+
+size_t Vbz::svb_decode_half(const u8 *in, size_t in_len, u32 *out, size_t n) {
+    size_t keys_len = (n + 7) / 8;
+    if (keys_len > in_len) return 0;
+
+    const u8 *keys = in, 
+             *data = in + keys_len, 
+             *end = in + in_len;
+
+    for (size_t i = 0; i < n; i++) {
+        u8 len = ((keys[i/8] >> (i%8)) & 1) + 1;
+        if (end - data < len) return i;
+
+        out[i] = len == 1 ? data[0] : data[0] | ((u32) data[1] << 8);
+        data += len;
+    }
+
+    return n;
+}
@@ -0,0 +1,70 @@
+/* MIT License
+ *
+ * Copyright (c) 2018 Sam Kovaka <skovaka@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _INCL_VBZ
+#define _INCL_VBZ
+
+#include <string>
+#include <vector>
+#include <hdf5.h>
+#include "util.hpp"
+
+//Decodes fast5 signal compressed by ONT's VBZ filter without the HDF5
+//plugin. Compressed chunks are read with H5Dread_chunk and decoded after
+//the HDF5 call returns, so decompression isn't serialized by the HDF5 lock
+//
+//VBZ chunks are StreamVByte encoded zigzag deltas, optionally compressed
+//with zstd. Zstd chunks (the default for MinKNOW) can only be decoded if
+//built with HAVE_ZSTD, otherwise they're left to HDF5
+class Vbz {
+    public:
+
+    static const H5Z_filter_t FILTER_ID = 32020;
+
+    //Returns false if the dataset can't be decoded natively,
+    //in which case it should be read through HDF5
+    static bool read_signal(hid_t file_id, 
+                            const std::string &path, 
+                            std::vector<i16> &signal);
+
+    //Decodes one filtered chunk into at most n values
+    //Filter options are {version, integer size, zigzag, zstd level}
+    static bool decode_chunk(const u8 *in, size_t in_len, 
+                             const u32 opts[4], 
+                             i16 *out, size_t n);
+
+    private:
+
+    //Filter options of the dataset chunks
+    enum Opt {VERSION, INT_SIZE, ZIGZAG, ZSTD_LEVEL};
+
+    //Version 0: 2-bit keys, 1-4 bytes per value
+    static size_t svb_decode(const u8 *in, size_t in_len, 
+                             u32 *out, size_t n);
+
+    //Version 1: 1-bit keys, 1-2 bytes per value
+    static size_t svb_decode_half(const u8 *in, size_t in_len, 
+                                  u32 *out, size_t n);
+};
+
+#endif
@@ -71,12 +71,55 @@ def get_parser(conf):
     add_map_opts(sim_parser, conf)
     add_ru_opts(sim_parser, conf)
 
+    fi_parser = sp.add_parser(
+            "fast5-index", 
+            help="Builds an index of the read IDs in fast5 files, used to quickly load a subset of reads", 
+            formatter_class=argparse.ArgumentDefaultsHelpFormatter
+    )
+    add_fast5_index_opts(fi_parser, conf)
+
+    sc_parser = sp.add_parser(
+            "signal-cache", 
+            help="Converts reads into a memory-mapped signal cache, which can be loaded much faster by \"uncalled sim\"", 
+            formatter_class=argparse.ArgumentDefaultsHelpFormatter
+    )
+    add_fast5_opts(sc_parser, conf)
+    sc_parser.add_argument(
+            "-o", "--out", 
+            type=str, required=True, 
+            help="Signal cache output filename. Will end with \"%s\"" % unc.SignalCache.SUFFIX
+    )
+
+    sg_parser = sp.add_parser(
+            "signal-gen", 
+            help="Generates synthetic reads from a reference and writes them to a signal cache, which can be mapped or simulated like real reads", 
+            formatter_class=argparse.ArgumentDefaultsHelpFormatter
+    )
+    sg_parser.add_argument(
+            "bwa_prefix", 
+            type=str, 
+            help="BWA prefix of the reference reads are sampled from. Only the .ann, .amb, and .pac files are used"
+    )
+    add_gen_opts(sg_parser, conf)
+    sg_parser.add_argument(
+            "-o", "--out", 
+            type=str, required=True, 
+            help="Signal cache output filename. Will end with \"%s\"" % unc.SignalCache.SUFFIX
+    )
+
     ps_parser = sp.add_parser(
             "pafstats", 
             help="Computes speed and accuracy of UNCALLED mappings.", #Given an UNCALLED PAF file, will compute mean/median BP mapped per second, number of BP required to map each read, and total number of milliseconds to map each read. Can also optionally compute accuracy with respect to reference alignments, for example output by minimap2.",
             formatter_class=argparse.ArgumentDefaultsHelpFormatter
     )
     unc.pafstats.add_opts(ps_parser)
+
+    pc_parser = sp.add_parser(
+            "pafconvert", 
+            help="Converts binary mappings output with --binary-paf to PAF", 
+            formatter_class=argparse.ArgumentDefaultsHelpFormatter
+    )
+    pc_parser.add_argument("infile", type=str, help="Binary mapping file output by UNCALLED")
     #TODO move here
 
     #lp_parser = sp.add_parser("list-ports", help="List the port of all MinION devices detected in the current MinKNOW session", formatter_class=argparse.ArgumentDefaultsHelpFormatter)
@@ -170,6 +213,26 @@ def add_ru_opts(p, conf):
             type=float, default=1, required=False, 
             help="Length of chunks in seconds"
     )
+    p.add_argument(
+            "--slice-time", 
+            type=float, default=conf.slice_time, required=False, 
+            help="Length of signal slices in seconds streamed to the mapper. Shorter slices let mapping start before a full chunk is received. --max-chunks still counts full chunks. If 0, slices are the same length as chunks"
+    )
+    p.add_argument(
+            "--signal-threads", 
+            type=int, default=conf.signal_threads, 
+            help="Number of threads dedicated to event detection and normalization. If 0, mapping threads also process the signal"
+    )
+    p.add_argument(
+            "--deadline-sched", action='store_const', 
+            const=unc.RealtimePool.DEADLINE, dest='schedule', 
+            help="Map the channels whose chunks have waited longest first, weighted by how soon a decision can be made, instead of in round-robin order"
+    )
+    p.add_argument(
+            "--shed-age", 
+            type=float, default=conf.shed_age, 
+            help="With --deadline-sched, give up on the read least likely to be mapped soon out of those whose signal has waited longer than this many seconds. If 0, reads are never shed"
+    )
 
     modes = p.add_mutually_exclusive_group(required=True)
     modes.add_argument(
@@ -199,6 +262,26 @@ def add_ru_opts(p, conf):
             const=unc.RealtimePool.ODD, dest='active_chs', 
             help="Will only monitor odd pores if set")
 
+def add_fast5_index_opts(p, conf):
+    p.add_argument(
+            "fast5s", nargs='+', type=str, 
+            help="Reads to index. Can be a directory which will be recursively searched for all files with the \".fast5\" extension, a text file containing one fast5 filename per line, or a comma-separated list of fast5 file names."
+    )
+    p.add_argument(
+            "-r", "--recursive", 
+            action="store_true"
+    )
+    p.add_argument(
+            "-o", "--out", 
+            type=str, required=True, 
+            help="Index output filename"
+    )
+    p.add_argument(
+            "-t", "--threads", 
+            type=int, default=conf.threads, 
+            help="Number of threads used to scan fast5 files"
+    )
+
 def add_sim_opts(p, conf):
     p.add_argument(
             "fast5s", nargs='+', type=str, 
@@ -208,6 +291,11 @@ def add_sim_opts(p, conf):
             "-r", "--recursive", 
             action="store_true"
     )
+    p.add_argument(
+            "--fast5-index", 
+            type=str, default=None, 
+            help=unc.Conf.fast5_index.__doc__
+    )
     p.add_argument(
             "--ctl-seqsum", 
             type=str, required=True, 
@@ -227,6 +315,23 @@ def add_sim_opts(p, conf):
             "--sim-speed", 
             type=float, default=conf.sim_speed, 
             help="")
+    p.add_argument(
+            "--virtual-time", 
+            action="store_true", 
+            help="Step simulation time from event to event instead of running in real time. Mapping time is measured and added to the simulated time")
+    p.add_argument(
+            "--compute-scale", 
+            type=float, default=conf.compute_scale, 
+            help="Multiplier applied to mapping time in --virtual-time mode. Setting to 0 ignores mapping time, so results don't depend on the speed of the machine")
+    p.add_argument(
+            "--load-threads", 
+            type=int, default=conf.load_threads, 
+            help=unc.Conf.load_threads.__doc__
+    )
+    p.add_argument(
+            "--max-loaded-mb", 
+            type=int, default=conf.max_loaded_mb, 
+            help="If set, reads are loaded in the background a few reads ahead of each channel and freed once simulated, using about this much memory for signal. Otherwise all reads are loaded before the simulation starts")
 
 def add_realtime_opts(p, conf):
     p.add_argument(
@@ -236,8 +341,13 @@ def add_realtime_opts(p, conf):
     )
     p.add_argument(
             "--port", 
-            type=int, default=conf.port, 
-            help=unc.Conf.port.__doc__
+            type=int, nargs="+", default=[conf.port], dest="ports",
+            help="MinKNOW port of each device. If multiple ports are given, one index and thread pool will be shared by all devices"
+    )
+    p.add_argument(
+            "--device-modes", 
+            nargs="+", choices=["enrich", "deplete"], default=None, dest="device_mode_strs",
+            help="Overrides --enrich/--deplete for each device, in the same order as --port"
     )
     p.add_argument(
             "--duration", 
@@ -271,6 +381,93 @@ def add_fast5_opts(p, conf):
             type=int, default=None, 
             help=unc.Conf.max_reads.__doc__
     )
+    p.add_argument(
+            "--load-threads", 
+            type=int, default=conf.load_threads, 
+            help=unc.Conf.load_threads.__doc__
+    )
+    p.add_argument(
+            "--fast5-index", 
+            type=str, default=None, 
+            help=unc.Conf.fast5_index.__doc__
+    )
+
+def add_gen_opts(p, conf):
+    p.add_argument(
+            "-n", "--gen-reads", 
+            type=int, required=True, 
+            help=unc.Conf.gen_reads.__doc__
+    )
+    p.add_argument(
+            "--num-channels", 
+            type=int, default=conf.num_channels, 
+            help="Number of channels reads are assigned to, in order of read index"
+    )
+    p.add_argument(
+            "--gen-seed", 
+            type=int, default=conf.gen_seed, 
+            help=unc.Conf.gen_seed.__doc__
+    )
+    p.add_argument(
+            "--min-read-len", 
+            type=int, default=conf.min_read_len, 
+            help=unc.Conf.min_read_len.__doc__
+    )
+    p.add_argument(
+            "--max-read-len", 
+            type=int, default=conf.max_read_len, 
+            help=unc.Conf.max_read_len.__doc__
+    )
+    p.add_argument(
+            "--unmapped-frac", 
+            type=float, default=conf.unmapped_frac, 
+            help=unc.Conf.unmapped_frac.__doc__
+    )
+    p.add_argument(
+            "--dwell-shape", 
+            type=float, default=conf.dwell_shape, 
+            help=unc.Conf.dwell_shape.__doc__
+    )
+    p.add_argument(
+            "--stay-prob", 
+            type=float, default=conf.stay_prob, 
+            help=unc.Conf.stay_prob.__doc__
+    )
+    p.add_argument(
+            "--skip-prob", 
+            type=float, default=conf.skip_prob, 
+            help=unc.Conf.skip_prob.__doc__
+    )
+    p.add_argument(
+            "--level-noise", 
+            type=float, default=conf.level_noise, 
+            help=unc.Conf.level_noise.__doc__
+    )
+    p.add_argument(
+            "--sample-noise", 
+            type=float, default=conf.sample_noise, 
+            help=unc.Conf.sample_noise.__doc__
+    )
+    p.add_argument(
+            "--scale-stdv", 
+            type=float, default=conf.scale_stdv, 
+            help=unc.Conf.scale_stdv.__doc__
+    )
+    p.add_argument(
+            "--shift-stdv", 
+            type=float, default=conf.shift_stdv, 
+            help=unc.Conf.shift_stdv.__doc__
+    )
+    p.add_argument(
+            "--drift", 
+            type=float, default=conf.drift, 
+            help=unc.Conf.drift.__doc__
+    )
+    p.add_argument(
+            "--read-gap", 
+            type=float, default=conf.read_gap, 
+            help=unc.Conf.read_gap.__doc__
+    )
 
 #TODO get defautls from conf
 def add_map_opts(p, conf):
@@ -279,6 +476,14 @@ def add_map_opts(p, conf):
             type=int, default=conf.threads, 
             help="Number of threads to use for mapping"
     )
+    p.add_argument(
+            "--numa", action="store_true", default=None,
+            help="Spread mapping threads evenly across NUMA nodes and load a copy of the index on each node, so threads only search local memory"
+    )
+    p.add_argument(
+            "--binary-paf", action="store_true", default=None,
+            help="Output mappings in a compact binary format instead of PAF. Can be read by \"uncalled pafstats\" or converted to PAF with \"uncalled pafconvert\""
+    )
     p.add_argument(
             "--num-channels", 
             type=int, default=conf.num_channels, 
@@ -106,8 +106,105 @@ class PafEntry:
         return s
 
 
+#Binary mapping format written with --binary-paf, see PafWriter in
+#src/paf_writer.hpp. Records can be loaded directly with numpy
+BIN_MAGIC = b"UNCLPAF"
+BIN_VERSION = 1
+BIN_HEADER_SIZE = 16
+BIN_FOOTER = np.dtype([("record_count", "<u8"), ("read_count", "<u4"), 
+                       ("ref_count", "<u4"), ("ref_names_len", "<u8"), 
+                       ("magic", "S8")])
+BIN_DTYPE = np.dtype([
+    ("st", "<i8"), ("read", "<u4"), ("ref", "<u4"),
+    ("rd_len", "<u4"), ("rd_st", "<u4"), ("rd_en", "<u4"), 
+    ("rf_st", "<u4"), ("rf_en", "<u4"), ("ch", "<i4"), ("dl", "<i4"),
+    ("mt", "<f4"), ("wt", "<f4"), ("qt", "<f4"), ("ej", "<f4"), 
+    ("kp", "<f4"), ("en", "<f4"), ("mx", "<f4"),
+    ("matches", "<u2"), ("tags", "<u2"), ("flags", "u1"), ("pad", "V3")
+])
+BIN_MAPPED, BIN_FWD = 1, 2
+
+#Bit of the "tags" field set for each stored tag (Paf::Tag values)
+BIN_TAGS = {"mt" : (0, 'f'), "wt" : (1, 'f'), "qt" : (2, 'f'), "ch" : (4, 'i'),
+            "ej" : (5, 'f'), "st" : (6, 'i'), "mx" : (7, 'f'), "en" : (10, 'f'),
+            "kp" : (11, 'f'), "dl" : (12, 'i')}
+
+def is_binary(fname):
+    with open(fname, "rb") as f:
+        return f.read(len(BIN_MAGIC)) == BIN_MAGIC
+
+class BinaryPaf:
+    def __init__(self, fname):
+        with open(fname, "rb") as f:
+            header = f.read(BIN_HEADER_SIZE)
+            f.seek(-BIN_FOOTER.itemsize, 2)
+            footer = np.frombuffer(f.read(BIN_FOOTER.itemsize), BIN_FOOTER)[0]
+
+            if not header.startswith(BIN_MAGIC) or footer["magic"] != BIN_MAGIC:
+                raise ValueError("\"%s\" is not a complete binary mapping file" % fname)
+
+            version = header[len(BIN_MAGIC)]
+            rec_size = np.frombuffer(header, "<u4", 1, 8)[0]
+            if version != BIN_VERSION or rec_size != BIN_DTYPE.itemsize:
+                raise ValueError("\"%s\" was written by an incompatible version" % fname)
+
+            n = int(footer["record_count"])
+            f.seek(BIN_HEADER_SIZE + n * BIN_DTYPE.itemsize)
+            self.ref_lens = np.frombuffer(f.read(8 * footer["ref_count"]), "<u8")
+            names = f.read(footer["ref_names_len"])
+            self.ref_names = [s.decode() for s in names.split(b"\0")[:-1]]
+            names = f.read()[:-BIN_FOOTER.itemsize]
+            self.read_names = [s.decode() for s in names.split(b"\0")[:-1]]
+
+        if n > 0:
+            self.records = np.memmap(fname, BIN_DTYPE, "r", BIN_HEADER_SIZE, (n,))
+        else:
+            self.records = np.zeros(0, BIN_DTYPE)
+
+    def __len__(self):
+        return len(self.records)
+
+    def is_mapped(self):
+        return (self.records["flags"] & BIN_MAPPED) != 0
+
+    def has_tag(self, k):
+        return (self.records["tags"] & (1 << BIN_TAGS[k][0])) != 0
+
+    #Converts records to PafEntrys. Records are converted to tuples in
+    #blocks, which is much faster than indexing each field
+    def entries(self, max_load=None, block=65536):
+        n = len(self.records) if max_load == None else min(max_load, len(self.records))
+        f = {k : i for i,k in enumerate(BIN_DTYPE.names)}
+        tag_fields = [(k, f[k], 1 << b, t) for k,(b,t) in BIN_TAGS.items()]
+
+        for st in range(0, n, block):
+            for r in self.records[st:min(n, st+block)].tolist():
+                #Floats are rounded like text PAF tags
+                tags = {k : (r[i] if t == 'i' else float("%f" % r[i]), t) 
+                        for k,i,b,t in tag_fields if r[f["tags"]] & b}
+
+                name = self.read_names[r[f["read"]]]
+                if r[f["flags"]] & BIN_MAPPED:
+                    ref = r[f["ref"]]
+                    rf_st, rf_en = r[f["rf_st"]], r[f["rf_en"]]
+                    tabs = [name, r[f["rd_len"]], r[f["rd_st"]], r[f["rd_en"]],
+                            bool(r[f["flags"]] & BIN_FWD), self.ref_names[ref], 
+                            int(self.ref_lens[ref]), rf_st, rf_en, r[f["matches"]], 
+                            rf_en - rf_st + 1, 255]
+                else:
+                    tabs = [name, r[f["rd_len"]]] + [None]*10
+
+                yield PafEntry(tabs, tags)
+
+    def __iter__(self):
+        return self.entries()
+
 def parse_paf(infile, max_load=None):
     if isinstance(infile, str):
+        if is_binary(infile):
+            for p in BinaryPaf(infile).entries(max_load):
+                yield p
+            return
         infile = open(infile)
     c = 0
     for l in infile:
@@ -158,12 +255,36 @@ def paf_ref_compare(qry, ref, ret_qry=True, check_locs=True, ext=1.5):
     return tp, tn, fp, fn, fp_unmap
 
 def add_opts(parser):
-    parser.add_argument("infile", type=str, help="PAF file output by UNCALLED")
+    parser.add_argument("infile", type=str, help="PAF or binary mapping file output by UNCALLED")
     parser.add_argument("-n", "--max-reads", required=False, type=int, default=None, help="Will only look at first n reads if specified")
     parser.add_argument("-r", "--ref-paf", required=False, type=str, default=None, help="Reference PAF file. Will output percent true/false positives/negatives with respect to reference. Reads not mapped in reference PAF will be classified as NA.")
     parser.add_argument("-a", "--annotate", action='store_true', help="Should be used with --ref-paf. Will output an annotated version of the input with T/P F/P specified in an 'rf' tag")
 
+#Computes summary and speed stats directly from binary records
+def run_binary(args):
+    pafs = BinaryPaf(args.infile)
+    recs = pafs.records[:args.max_reads]
+    n = len(recs)
+    mapped = (recs["flags"] & BIN_MAPPED) != 0
+    num_mapped = np.sum(mapped)
+
+    sys.stdout.write("Summary: %d reads, %d mapped (%.2f%%)\n\n" % (n, num_mapped, 100*num_mapped/n))
+
+    if n > 0 and recs[0]["tags"] & (1 << BIN_TAGS["mt"][0]):
+        map_ms = recs["mt"][mapped].astype(float)
+        map_bp = recs["rd_en"][mapped].astype(float)
+        map_bpps = 1000*map_bp/map_ms
+
+        sys.stdout.write("Speed            Mean    Median\n")
+        sys.stdout.write("BP per sec: %9.2f %9.2f\n" % (np.mean(map_bpps), np.median(map_bpps)))
+        sys.stdout.write("BP mapped:  %9.2f %9.2f\n" % (np.mean(map_bp),   np.median(map_bp)))
+        sys.stdout.write("MS to map:  %9.2f %9.2f\n" % (np.mean(map_ms),   np.median(map_ms)))
+
 def run(args):
+    if args.ref_paf == None and is_binary(args.infile):
+        run_binary(args)
+        return
+
     locs = [p for p in parse_paf(args.infile, args.max_reads)]
 
     num_mapped = sum([p.is_mapped for p in locs])